@@ -2,8 +2,15 @@
 #include "TLFXPugiXMLLoader.h"
 
 #include <IwGx.h>
+#include <IwImage.h>
 
 #include <cmath>
+#include <cstring>
+
+MarmaladeEffectsLibrary::~MarmaladeEffectsLibrary()
+{
+    DestroyAtlasPages();
+}
 
 TLFX::XMLLoader* MarmaladeEffectsLibrary::CreateLoader() const
 {
@@ -15,6 +22,78 @@ TLFX::AnimImage* MarmaladeEffectsLibrary::CreateImage() const
     return new MarmaladeImage();
 }
 
+bool MarmaladeEffectsLibrary::CreateAtlasPages( const TLFX::TextureAtlas& atlas )
+{
+    DestroyAtlasPages();
+
+    std::vector<CIwImage*> pages(atlas.GetPageCount());
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        pages[i] = new CIwImage();
+        pages[i]->SetFormat(CIwImage::ABGR_8888);
+        pages[i]->SetWidth(atlas.GetPageWidth());
+        pages[i]->SetHeight(atlas.GetPageHeight());
+        pages[i]->SetBuffers();
+        memset(pages[i]->GetTexels(), 0, pages[i]->GetPitch() * pages[i]->GetHeight());
+    }
+
+    bool copied = true;
+    for (auto it = _shapeList.begin(); it != _shapeList.end() && copied; ++it)
+    {
+        MarmaladeImage *shape = static_cast<MarmaladeImage*>(*it);
+        CIwImage source, image;
+        source.LoadFromFile(shape->GetFilename());
+        image.SetFormat(CIwImage::ABGR_8888);
+        source.ConvertToImage(&image);
+
+        CIwImage *page = pages[shape->GetAtlasPage()];
+        int width = (int)shape->GetWidth(), height = (int)shape->GetHeight();
+        for (int frame = 0; frame < shape->GetFramesCount(); ++frame)
+        {
+            int sx, sy, dx, dy;
+            shape->GetFrameSource(frame, sx, sy);
+            shape->GetAtlasFramePosition(frame, dx, dy);
+            if (sx + width > (int)image.GetWidth() || sy + height > (int)image.GetHeight())
+            {
+                copied = false;                 // frames don't match the image
+                break;
+            }
+
+            for (int row = 0; row < height; ++row)
+                memcpy(page->GetTexels() + (dy + row) * page->GetPitch() + dx * 4, image.GetTexels() + (sy + row) * image.GetPitch() + sx * 4, width * 4);
+        }
+    }
+
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        if (copied)
+        {
+            CIwTexture *texture = new CIwTexture();
+            texture->CopyFromImage(pages[i]);
+            texture->Upload();
+            _atlasPages.push_back(texture);
+        }
+        delete pages[i];
+    }
+
+    if (!copied)
+        return false;
+
+    for (auto it = _shapeList.begin(); it != _shapeList.end(); ++it)
+        static_cast<MarmaladeImage*>(*it)->SetAtlasTexture(_atlasPages[(*it)->GetAtlasPage()]);
+    return true;
+}
+
+void MarmaladeEffectsLibrary::DestroyAtlasPages()
+{
+    for (auto it = _shapeList.begin(); it != _shapeList.end(); ++it)
+        static_cast<MarmaladeImage*>(*it)->SetAtlasTexture(NULL);
+
+    for (auto it = _atlasPages.begin(); it != _atlasPages.end(); ++it)
+        delete *it;
+    _atlasPages.clear();
+}
+
 
 
 bool MarmaladeImage::Load( const char *filename )
@@ -22,12 +101,14 @@ bool MarmaladeImage::Load( const char *filename )
     _texture = new CIwTexture();
     _texture->LoadFromFile(filename);
     _texture->Upload();           //upload on load?
+    SetTextureSize(_texture->GetWidth(), _texture->GetHeight());
     // how to detect failure?
     return true;
 }
 
 MarmaladeImage::MarmaladeImage()
     : _texture(NULL)
+    , _atlasTexture(NULL)
 {
 
 }
@@ -38,131 +119,124 @@ MarmaladeImage::~MarmaladeImage()
         delete _texture;
 }
 
+bool MarmaladeImage::Trim( int threshold, int vertices )
+{
+    CIwImage source, image;
+    source.LoadFromFile(GetFilename());
+    image.SetFormat(CIwImage::ABGR_8888);
+    source.ConvertToImage(&image);
+    if (!image.GetTexels())
+        return false;
+
+    return BuildHulls(image.GetTexels() + 3, 4, image.GetPitch(), threshold, vertices);    // alpha is the last byte
+}
+
 CIwTexture* MarmaladeImage::GetTexture() const
 {
-    return _texture;
+    return _atlasTexture ? _atlasTexture : _texture;
+}
+
+void MarmaladeImage::SetAtlasTexture( CIwTexture* texture )
+{
+    _atlasTexture = texture;
 }
 
 MarmaladeParticleManager::MarmaladeParticleManager( int particles /*= particleLimit*/, int layers /*= 1*/ )
-    : TLFX::ParticleManager(particles, layers)
-    , _lastSprite(NULL)
+    : TLFX::BasicParticleManager<MarmaladeParticleManager>(particles, layers)
+    , _lastTexture(NULL)
     , _lastAdditive(true)
+    , _batchVertices(0)
 {
 
 }
 
 void MarmaladeParticleManager::DrawSprite( TLFX::AnimImage* sprite, float px, float py, float frame, float x, float y, float rotation, float scaleX, float scaleY, unsigned char r, unsigned char g, unsigned char b, float a , bool additive )
 {
-    IwAssert(MARM, frame == 0);
-
     unsigned char alpha = (unsigned char)(a * 255);
     if (alpha == 0 || scaleX == 0 || scaleY == 0) return;
 
-    if (sprite != _lastSprite || additive != _lastAdditive)
+    Batch batch;
+    batch.hullCount = sprite->GetFrameHull((int)frame, batch.hull);
+    if (batch.hullCount < 3) return;
+
+    CIwTexture *texture = static_cast<MarmaladeImage*>(sprite)->GetTexture();
+    if (texture != _lastTexture || additive != _lastAdditive || _batchVertices + batch.hullCount > 0xffff)
         Flush();
 
-    Batch batch;
     batch.px = px;
     batch.py = py;
-    batch.frame = frame;
     batch.x = x;
     batch.y = y;
+    batch.width = sprite->GetWidth();
+    batch.height = sprite->GetHeight();
     batch.rotation = rotation;
     batch.scaleX = scaleX;
     batch.scaleY = scaleY;
+    sprite->GetFrameUV((int)frame, batch.u0, batch.v0, batch.u1, batch.v1);
     batch.color.Set(r, g, b, alpha);
     _batch.push_back(batch);
+    _batchVertices += batch.hullCount;
 
-    _lastSprite = sprite;
+    _lastTexture = texture;
     _lastAdditive = additive;
 }
 
 void MarmaladeParticleManager::Flush()
 {
-    if (!_batch.empty() && _lastSprite)
+    if (!_batch.empty() && _lastTexture)
     {
-        int count = _batch.size();
-        int count4 = count * 4;
+        int count = _batchVertices;
+        int indexCount = (count - 2 * (int)_batch.size()) * 3;
 
-        CIwColour *colors = IW_GX_ALLOC(CIwColour, count4);
-        CIwFVec2 *uvs = IW_GX_ALLOC(CIwFVec2, count4);
-        CIwFVec2 *verts = IW_GX_ALLOC(CIwFVec2, count4);
-        uint16 *indices = IW_GX_ALLOC(uint16, count4);
+        CIwColour *colors = IW_GX_ALLOC(CIwColour, count);
+        CIwFVec2 *uvs = IW_GX_ALLOC(CIwFVec2, count);
+        CIwFVec2 *verts = IW_GX_ALLOC(CIwFVec2, count);
+        uint16 *indices = IW_GX_ALLOC(uint16, indexCount);
 
-        int index = 0;
-        for (auto it = _batch.begin(); it != _batch.end(); ++it, index += 4)
+        // every sprite is a fan of triangles over the outline of its frame, 4 corners unless the shapes are trimmed
+        int index = 0, triangle = 0;
+        for (auto it = _batch.begin(); it != _batch.end(); ++it)
         {
-            for (int i = 0; i < 4; ++i)
+            float cos = cosf(it->rotation / 180.f * (float)M_PI);
+            float sin = sinf(it->rotation / 180.f * (float)M_PI);
+
+            for (int i = 0; i < it->hullCount; ++i)
             {
+                float s = it->hull[i].x, t = it->hull[i].y;
+                float x = (-it->x + t * it->width) * it->scaleX;
+                float y = (-it->y + s * it->height) * it->scaleY;
+
                 colors[index + i].Set(it->color.r, it->color.g, it->color.b, it->color.a);
-                indices[index + i] = index + i;
+                uvs[index + i].x = it->u0 + s * (it->u1 - it->u0);
+                uvs[index + i].y = it->v0 + t * (it->v1 - it->v0);
+                verts[index + i].x = it->px + x * cos - y * sin;
+                verts[index + i].y = it->py + x * sin + y * cos;
             }
 
-            uvs[index + 0].x = 0;
-            uvs[index + 0].y = 0;
-            uvs[index + 1].x = 1.0f;
-            uvs[index + 1].y = 0;
-            uvs[index + 2].x = 1.0f;
-            uvs[index + 2].y = 1.0f;
-            uvs[index + 3].x = 0;
-            uvs[index + 3].y = 1.0f;
-
-
-            /*
-            verts[index + 0].x = it->px - it->x * it->scaleX;
-            verts[index + 0].y = it->py - it->y * it->scaleY;
-            //verts[index + 0].z = 1.0f;
-            verts[index + 1].x = verts[index + 0].x + _lastSprite->GetWidth() * it->scaleX;
-            verts[index + 1].y = verts[index + 0].y;
-            //verts[index + 1].z = 1.0f;
-            verts[index + 2].x = verts[index + 1].x;
-            verts[index + 2].y = verts[index + 1].y + _lastSprite->GetHeight() * it->scaleY;
-            //verts[index + 2].z = 1.0f;
-            verts[index + 3].x = verts[index + 0].x;
-            verts[index + 3].y = verts[index + 2].y;
-            //verts[index + 3].z = 1.0f;
-            */
-
-            float x0 = -it->x * it->scaleX;
-            float y0 = -it->y * it->scaleY;
-            float x1 = x0;
-            float y1 = (-it->y + _lastSprite->GetHeight()) * it->scaleY;
-            float x2 = (-it->x + _lastSprite->GetWidth()) * it->scaleX;
-            float y2 = y1;
-            float x3 = x2;
-            float y3 = y0;
-
-            float cos = cosf(it->rotation / 180.f * (float)M_PI);
-            float sin = sinf(it->rotation / 180.f * (float)M_PI);
-
-            verts[index + 0].x = it->px + x0 * cos - y0 * sin;
-            verts[index + 0].y = it->py + x0 * sin + y0 * cos;
-            //verts[index + 0].z = 1.0f;
-            verts[index + 1].x = it->px + x1 * cos - y1 * sin;
-            verts[index + 1].y = it->py + x1 * sin + y1 * cos;
-            //verts[index + 1].z = 1.0f;
-            verts[index + 2].x = it->px + x2 * cos - y2 * sin;
-            verts[index + 2].y = it->py + x2 * sin + y2 * cos;
-            //verts[index + 2].z = 1.0f;
-            verts[index + 3].x = it->px + x3 * cos - y3 * sin;
-            verts[index + 3].y = it->py + x3 * sin + y3 * cos;
-            //verts[index + 3].z = 1.0f;
+            for (int i = 2; i < it->hullCount; ++i, triangle += 3)
+            {
+                indices[triangle + 0] = index;
+                indices[triangle + 1] = index + i - 1;
+                indices[triangle + 2] = index + i;
+            }
+            index += it->hullCount;
         }
 
         //IwGxSetModelMatrix(&modelTransform);
         IwGxSetUVStream(uvs);
-        IwGxSetVertStreamScreenSpace(verts, count4);
-        IwGxSetColStream(colors, count4);
+        IwGxSetVertStreamScreenSpace(verts, count);
+        IwGxSetColStream(colors, count);
         IwGxSetNormStream(NULL);
 
         CIwMaterial* mat = IW_GX_ALLOC_MATERIAL();
-        mat->SetTexture(static_cast<MarmaladeImage*>(_lastSprite)->GetTexture());
+        mat->SetTexture(_lastTexture);
         mat->SetDepthWriteMode(CIwMaterial::DEPTH_WRITE_DISABLED);
         mat->SetAlphaMode(_lastAdditive ? CIwMaterial::ALPHA_ADD : CIwMaterial::ALPHA_BLEND);
         IwGxSetMaterial(mat);
 
-        IwGxDrawPrims(IW_GX_QUAD_LIST, indices, count4);
+        IwGxDrawPrims(IW_GX_TRI_LIST, indices, indexCount);
 
         _batch.clear();
+        _batchVertices = 0;
     }
 }
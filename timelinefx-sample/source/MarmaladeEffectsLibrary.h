@@ -11,7 +11,7 @@
 #define _MARMALADEEFFECTSLIBRARY_H
 
 #include "TLFXEffectsLibrary.h"
-#include "TLFXParticleManager.h"
+#include "TLFXBasicParticleManager.h"
 #include "TLFXAnimImage.h"
 
 #include <IwTexture.h>
@@ -21,12 +21,22 @@ class XMLLoader;
 class MarmaladeEffectsLibrary : public TLFX::EffectsLibrary
 {
 public:
+    ~MarmaladeEffectsLibrary();
+
     virtual TLFX::XMLLoader* CreateLoader() const;
     virtual TLFX::AnimImage* CreateImage() const;
+
+protected:
+    virtual bool CreateAtlasPages(const TLFX::TextureAtlas& atlas);
+    virtual void DestroyAtlasPages();
+
+    std::vector<CIwTexture*> _atlasPages;
 };
 
-class MarmaladeParticleManager : public TLFX::ParticleManager
+// DrawSprite is called without the virtual dispatch, overriding it in a derived class has no effect, see TLFX::BasicParticleManager
+class MarmaladeParticleManager : public TLFX::BasicParticleManager<MarmaladeParticleManager>
 {
+    friend class TLFX::ParticleManager;     // calls DrawSprite inlined
 public:
     MarmaladeParticleManager(int particles = TLFX::ParticleManager::particleLimit, int layers = 1);
     void Flush();
@@ -38,14 +48,18 @@ protected:
     struct Batch
     {
         float px, py;
-        float frame;
         float x, y;
+        float width, height;
         float rotation;
         float scaleX, scaleY;
+        float u0, v0, u1, v1;
         CIwColour color;
+        const TLFX::Vector2* hull;          // drawn as a fan of triangles
+        int hullCount;
     };
     std::list<Batch> _batch;
-    TLFX::AnimImage *_lastSprite;
+    int              _batchVertices;
+    CIwTexture      *_lastTexture;      // sprites on the same atlas page batch together
     bool             _lastAdditive;
 };
 
@@ -56,10 +70,17 @@ public:
     ~MarmaladeImage();
 
     bool Load(const char *filename);
+    bool Trim(int threshold, int vertices);
+
+    /**
+     * The atlas page when the image is in the atlas, its own texture otherwise
+     */
     CIwTexture* GetTexture() const;
+    void SetAtlasTexture(CIwTexture* texture);
 
 protected:
     CIwTexture *_texture;
+    CIwTexture *_atlasTexture;
 };
 
 #endif // _MARMALADEEFFECTSLIBRARY_H
@@ -20,6 +20,8 @@ void Init()
     IwGxLightingOff();
 
     gEffects = new MarmaladeEffectsLibrary();
+    gEffects->SetAtlasPageSize(2048);       // all shapes on one page, drawn in a batch per blend mode
+    gEffects->SetTrimThreshold(0);          // leave out the transparent parts of the frames
     gEffects->Load("particles/data.xml");
 
     gPM = new MarmaladeParticleManager();
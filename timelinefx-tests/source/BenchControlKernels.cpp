@@ -0,0 +1,151 @@
+/*
+ * Cost per particle of Emitter::ControlParticles with the generic kernel, which has every feature, and with the kernel specialized
+ * for the bypassers of each emitter by Emitter::AnalyseEmitter, for every effect in the sample. The same particles are controlled
+ * by both, taking turns.
+ *
+ *   make bench
+ *   BenchControlKernels [data directory]
+ */
+
+#include "TestSupport.h"
+
+#include "TLFXParticleManager.h"
+#include "TLFXEffect.h"
+#include "TLFXEmitter.h"
+#include "TLFXParticle.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+
+    class NullParticleManager : public TLFX::ParticleManager
+    {
+    public:
+        NullParticleManager() : TLFX::ParticleManager(TLFX::ParticleManager::particleLimit, 1) {}
+
+        // the effects still alive, on every layer
+        std::vector<TLFX::Effect*> GetLiveEffects() const
+        {
+            std::vector<TLFX::Effect*> effects;
+            for (auto layer = _effects.begin(); layer != _effects.end(); ++layer)
+                effects.insert(effects.end(), layer->begin(), layer->end());
+            return effects;
+        }
+
+    protected:
+        virtual void DrawSprite(TLFX::AnimImage* /*sprite*/, float /*px*/, float /*py*/, float /*frame*/, float /*x*/, float /*y*/,
+            float /*rotation*/, float /*scaleX*/, float /*scaleY*/, unsigned char /*r*/, unsigned char /*g*/, unsigned char /*b*/,
+            float /*a*/, bool /*additive*/) {}
+    };
+
+    struct Controlled
+    {
+        TLFX::Emitter* emitter;
+        std::vector<TLFX::Particle*> particles;
+    };
+
+    // the live particles of every emitter of an effect and its sub effects
+    void Collect( TLFX::Effect* effect, std::vector<Controlled>& controlled )
+    {
+        const auto& emitters = effect->GetChildren();
+        for (auto it = emitters.begin(); it != emitters.end(); ++it)
+        {
+            Controlled c;
+            c.emitter = static_cast<TLFX::Emitter*>(*it);
+            const auto& particles = c.emitter->GetChildren();
+            for (auto p = particles.begin(); p != particles.end(); ++p)
+            {
+                c.particles.push_back(static_cast<TLFX::Particle*>(*p));
+                const auto& subEffects = (*p)->GetChildren();
+                for (auto sub = subEffects.begin(); sub != subEffects.end(); ++sub)
+                    Collect(static_cast<TLFX::Effect*>(*sub), controlled);
+            }
+            if (!c.particles.empty())
+                controlled.push_back(c);
+        }
+    }
+
+    // time of controlling every particle once in nanoseconds
+    double Control( std::vector<Controlled>& controlled, bool generic )
+    {
+        for (auto it = controlled.begin(); it != controlled.end(); ++it)
+            it->emitter->SetGenericControl(generic);
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto it = controlled.begin(); it != controlled.end(); ++it)
+            it->emitter->ControlParticles(&it->particles[0], (int)it->particles.size());
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void Measure( const char *name, TLFX::Effect* effect, double& genericTotal, double& specializedTotal )
+    {
+        // 20 copies of the effect, 30 updates in, before short explosions burn out
+        NullParticleManager pm;
+        pm.SetScreenSize(4000, 4000);
+        srand(1);
+        for (int i = 0; i < 20; ++i)
+        {
+            TLFX::Effect* copy = new TLFX::Effect(*effect, &pm);
+            copy->SetPosition((float)(rand() % 2000 - 1000), (float)(rand() % 2000 - 1000));
+            pm.AddEffect(copy);
+        }
+        for (int i = 0; i < 30; ++i)
+            pm.Update();
+
+        std::vector<Controlled> controlled;
+        std::vector<TLFX::Effect*> effects = pm.GetLiveEffects();
+        for (auto it = effects.begin(); it != effects.end(); ++it)
+            Collect(*it, controlled);
+
+        int particles = 0, specialized = 0;
+        for (auto it = controlled.begin(); it != controlled.end(); ++it)
+        {
+            particles += (int)it->particles.size();
+            specialized += !it->emitter->IsGenericControl();
+        }
+        if (particles == 0)
+        {
+            printf("%s: no particles\n", name);
+            return;
+        }
+
+        // best of many, taking turns so both see the same caches and clock speed
+        double genericTime = 1e30, specializedTime = 1e30;
+        for (int repeat = 0; repeat < 50; ++repeat)
+        {
+            genericTime = std::min(genericTime, Control(controlled, true));
+            specializedTime = std::min(specializedTime, Control(controlled, false));
+        }
+        genericTotal += genericTime;
+        specializedTotal += specializedTime;
+
+        printf("%s: %d particles, %d of %d emitters specialized, generic %.2f ns, specialized %.2f ns per particle (%.1f%%)\n", name,
+            particles, specialized, (int)controlled.size(), genericTime / particles, specializedTime / particles,
+            100.0 * (1.0 - specializedTime / genericTime));
+    }
+
+} // namespace
+
+int main( int /*argc*/, char ** /*argv*/ )
+{
+    TLFXTest::TestEffectsLibrary library;
+    if (!TLFX_CHECK(library.Load(TLFXTest::libraryFile)))
+        return TLFXTest::Finish("BenchControlKernels");
+
+    double genericTotal = 0, specializedTotal = 0;
+    const auto& effects = library.GetEffects();
+    for (auto it = effects.begin(); it != effects.end(); ++it)
+    {
+        if (TLFXTest::TestEffectsLibrary::IsTopLevel(it->first))
+            Measure(it->first.c_str(), it->second, genericTotal, specializedTotal);
+    }
+    TLFX_CHECK(specializedTotal > 0);
+    printf("all effects: generic %.0f us, specialized %.0f us, saving %.1f%%\n", genericTotal / 1000, specializedTotal / 1000,
+        100.0 * (1.0 - specializedTotal / genericTotal));
+
+    return TLFXTest::Finish("BenchControlKernels");
+}
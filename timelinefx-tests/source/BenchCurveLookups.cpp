@@ -0,0 +1,170 @@
+/*
+ * Cost of the over time curve lookups of the particles of every effect in the sample, with the curves classified as they are compiled
+ * and with the same tables forced to EmitterArray::ShapeSampled, which takes no shortcut for constant and linear curves. Both look up
+ * the same values, so the difference is the shortcut. Measured one particle at a time (EmitterArray::GetOT, as ControlParticle does)
+ * and in batches (EmitterArray::EvaluateOT, as ControlParticles does).
+ *
+ *   make bench
+ *   BenchCurveLookups [data directory]
+ */
+
+#include "TestSupport.h"
+
+#include "TLFXEmitter.h"
+#include "TLFXEmitterArray.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+
+    // a copy of a compiled curve, keeping its shape or taking the lookup of a sampled table
+    class BenchArray : public TLFX::EmitterArray
+    {
+    public:
+        BenchArray(const TLFX::EmitterArray& array, bool classified) : TLFX::EmitterArray(array)
+        {
+            if (!classified)
+                _shape = ShapeSampled;
+        }
+    };
+
+    struct Curves
+    {
+        std::vector<BenchArray> arrays;
+        std::vector<float> ages, lifetimes;     // of the particles looking them up
+    };
+
+    const int particles = 256;                  // per emitter
+    const int batchSize = 64;                   // as Emitter::ControlParticles
+
+    // the over time curves of every emitter of an effect, with particles spread over their life
+    Curves Collect( const std::vector<TLFX::Emitter*>& emitters, bool classified )
+    {
+        Curves curves;
+        srand(1);
+        for (auto it = emitters.begin(); it != emitters.end(); ++it)
+        {
+            std::vector<const TLFX::EmitterArray*> arrays;
+            (*it)->GetOverTimeArrays(arrays);
+            float life = std::max((*it)->GetEmitterLife(0), 100.0f);
+            for (int i = 0; i < particles; ++i)
+            {
+                float lifetime = life * (0.5f + 0.5f * rand() / RAND_MAX);
+                curves.lifetimes.push_back(lifetime);
+                curves.ages.push_back(lifetime * rand() / RAND_MAX);
+            }
+            for (auto array = arrays.begin(); array != arrays.end(); ++array)
+                curves.arrays.push_back(BenchArray(**array, classified));
+        }
+        return curves;
+    }
+
+    // every particle of an emitter looks up every curve of the emitter
+    template <class Lookup>
+    float Run( const Curves& curves, Lookup lookup )
+    {
+        float sum = 0;
+        size_t arraysPerEmitter = curves.arrays.size() / (curves.ages.size() / particles);
+        for (size_t i = 0; i < curves.arrays.size(); ++i)
+        {
+            size_t first = i / arraysPerEmitter * particles;
+            sum += lookup(curves.arrays[i], &curves.ages[first], &curves.lifetimes[first]);
+        }
+        return sum;
+    }
+
+    float LookupEach( const TLFX::EmitterArray& array, const float* ages, const float* lifetimes )
+    {
+        float sum = 0;
+        for (int i = 0; i < particles; ++i)
+            sum += array.GetOT(ages[i], lifetimes[i]);
+        return sum;
+    }
+
+    float LookupBatches( const TLFX::EmitterArray& array, const float* ages, const float* lifetimes )
+    {
+        float out[batchSize];
+        float sum = 0;
+        for (int first = 0; first < particles; first += batchSize)
+        {
+            array.EvaluateOT(ages + first, lifetimes + first, out, batchSize);
+            for (int i = 0; i < batchSize; ++i)
+                sum += out[i];
+        }
+        return sum;
+    }
+
+    // time of a run in nanoseconds, best of many, taking turns so both see the same caches and clock speed
+    template <class Lookup>
+    void Time( const Curves& classified, const Curves& sampled, Lookup lookup, double& classifiedTime, double& sampledTime )
+    {
+        classifiedTime = sampledTime = 1e30;
+        float classifiedSum = 0, sampledSum = 0;
+        for (int repeat = 0; repeat < 50; ++repeat)
+        {
+            auto start = std::chrono::steady_clock::now();
+            classifiedSum = Run(classified, lookup);
+            auto middle = std::chrono::steady_clock::now();
+            sampledSum = Run(sampled, lookup);
+            auto end = std::chrono::steady_clock::now();
+            classifiedTime = std::min(classifiedTime, std::chrono::duration<double, std::nano>(middle - start).count());
+            sampledTime = std::min(sampledTime, std::chrono::duration<double, std::nano>(end - middle).count());
+        }
+        TLFX_CHECK(classifiedSum == sampledSum);
+    }
+
+    void Measure( const char *name, const std::vector<TLFX::Emitter*>& emitters, double& classifiedTotal, double& sampledTotal )
+    {
+        Curves classified = Collect(emitters, true);
+        Curves sampled = Collect(emitters, false);
+        if (!TLFX_CHECK(!classified.arrays.empty()))
+            return;
+
+        int constant = 0, linear = 0;
+        for (auto it = classified.arrays.begin(); it != classified.arrays.end(); ++it)
+        {
+            constant += it->GetShape() == TLFX::EmitterArray::ShapeConstant;
+            linear += it->GetShape() == TLFX::EmitterArray::ShapeLinear;
+        }
+
+        double eachClassified, eachSampled, batchClassified, batchSampled;
+        Time(classified, sampled, LookupEach, eachClassified, eachSampled);
+        Time(classified, sampled, LookupBatches, batchClassified, batchSampled);
+        classifiedTotal += eachClassified + batchClassified;
+        sampledTotal += eachSampled + batchSampled;
+
+        double lookups = (double)classified.arrays.size() * particles;
+        printf("%s: %d curves, %d constant, %d linear, per lookup each %.2f ns sampled %.2f ns, batched %.2f ns sampled %.2f ns\n", name,
+            (int)classified.arrays.size(), constant, linear, eachClassified / lookups, eachSampled / lookups, batchClassified / lookups,
+            batchSampled / lookups);
+    }
+
+} // namespace
+
+int main( int /*argc*/, char ** /*argv*/ )
+{
+    TLFXTest::TestEffectsLibrary library;
+    if (!TLFX_CHECK(library.Load(TLFXTest::libraryFile)))
+        return TLFXTest::Finish("BenchCurveLookups");
+
+    // emitters by the top level effect they belong to, sub effects included
+    std::map<std::string, std::vector<TLFX::Emitter*> > effects;
+    const auto& emitters = library.GetEmitters();
+    for (auto it = emitters.begin(); it != emitters.end(); ++it)
+    {
+        size_t effect = it->first.find('/', it->first.find('/') + 1);
+        effects[it->first.substr(0, effect)].push_back(it->second);
+    }
+
+    double classifiedTotal = 0, sampledTotal = 0;
+    for (auto it = effects.begin(); it != effects.end(); ++it)
+        Measure(it->first.c_str(), it->second, classifiedTotal, sampledTotal);
+    printf("all effects: classified %.0f us, sampled %.0f us, saving %.1f%%\n", classifiedTotal / 1000, sampledTotal / 1000,
+        100.0 * (1.0 - classifiedTotal / sampledTotal));
+
+    return TLFXTest::Finish("BenchCurveLookups");
+}
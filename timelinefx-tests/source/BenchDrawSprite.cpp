@@ -0,0 +1,144 @@
+/*
+ * Cost per particle of drawing through the virtual ParticleManager::DrawSprite and through the DrawSprite of a BasicParticleManager,
+ * which the draw loop calls directly. Both managers batch the sprites the same way, into a vector of vertices, and draw the same
+ * particles, so the difference is the call. Measured for live particles and for pipelined snapshots.
+ *
+ *   make bench
+ *   BenchDrawSprite [data directory] [effect]
+ */
+
+#include "TestSupport.h"
+
+#include "TLFXBasicParticleManager.h"
+#include "TLFXEffect.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+
+    struct Vertex
+    {
+        float x, y, frame, scale;
+        unsigned int color;
+    };
+
+    struct Batch
+    {
+        std::vector<Vertex> vertices;
+
+        void Add(float px, float py, float frame, float scaleX, unsigned char r, unsigned char g, unsigned char b, float a)
+        {
+            Vertex v = { px, py, frame, scaleX, r | (g << 8) | (b << 16) | ((unsigned int)(a * 255) << 24) };
+            vertices.push_back(v);
+        }
+    };
+
+    class VirtualParticleManager : public TLFX::ParticleManager
+    {
+    public:
+        VirtualParticleManager() : TLFX::ParticleManager(20000, 1) {}
+
+        Batch batch;
+
+    protected:
+        virtual void DrawSprite(TLFX::AnimImage* /*sprite*/, float px, float py, float frame, float /*x*/, float /*y*/, float /*rotation*/,
+            float scaleX, float /*scaleY*/, unsigned char r, unsigned char g, unsigned char b, float a, bool /*additive*/)
+        {
+            batch.Add(px, py, frame, scaleX, r, g, b, a);
+        }
+    };
+
+    class InlinedParticleManager : public TLFX::BasicParticleManager<InlinedParticleManager>
+    {
+        friend class TLFX::ParticleManager;
+    public:
+        InlinedParticleManager() : TLFX::BasicParticleManager<InlinedParticleManager>(20000, 1) {}
+
+        Batch batch;
+
+    protected:
+        virtual void DrawSprite(TLFX::AnimImage* /*sprite*/, float px, float py, float frame, float /*x*/, float /*y*/, float /*rotation*/,
+            float scaleX, float /*scaleY*/, unsigned char r, unsigned char g, unsigned char b, float a, bool /*additive*/)
+        {
+            batch.Add(px, py, frame, scaleX, r, g, b, a);
+        }
+    };
+
+    // 40 copies of the effect, 60 updates in
+    template <class Manager>
+    void Start( Manager& pm, TLFX::Effect* effect, bool pipelined )
+    {
+        pm.SetScreenSize(4000, 4000);
+        pm.SetPipelined(pipelined);
+        srand(1);
+        for (int i = 0; i < 40; ++i)
+        {
+            TLFX::Effect* copy = new TLFX::Effect(*effect, &pm);
+            copy->SetPosition((float)(rand() % 2000 - 1000), (float)(rand() % 2000 - 1000));
+            pm.AddEffect(copy);
+        }
+        for (int i = 0; i < 60; ++i)
+            pm.Update();
+        pm.batch.vertices.reserve(200000);
+    }
+
+    // time of a draw in nanoseconds, averaged over a few
+    template <class Manager>
+    double Draw( Manager& pm )
+    {
+        const int draws = 10;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < draws; ++i)
+        {
+            pm.batch.vertices.clear();
+            pm.DrawParticles(0.5f);
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / draws;
+    }
+
+    void Measure( TLFX::Effect* effect, const char *name, bool pipelined )
+    {
+        VirtualParticleManager virtualManager;
+        InlinedParticleManager inlinedManager;
+        Start(virtualManager, effect, pipelined);
+        Start(inlinedManager, effect, pipelined);
+
+        // best of many, taking turns so both see the same caches and clock speed
+        double virtualTime = 1e30, inlinedTime = 1e30;
+        for (int repeat = 0; repeat < 100; ++repeat)
+        {
+            virtualTime = std::min(virtualTime, Draw(virtualManager));
+            inlinedTime = std::min(inlinedTime, Draw(inlinedManager));
+        }
+        size_t sprites = virtualManager.batch.vertices.size();
+        if (!TLFX_CHECK(sprites == inlinedManager.batch.vertices.size() && sprites > 0))
+            return;
+
+        double virtualCost = virtualTime / sprites;
+        double inlinedCost = inlinedTime / sprites;
+        printf("%s, %s: %d sprites, virtual %.2f ns, inlined %.2f ns per sprite, saving %.2f ns (%.1f%%)\n", name, pipelined ? "pipelined" : "live",
+            (int)sprites, virtualCost, inlinedCost, virtualCost - inlinedCost, 100.0 * (1.0 - inlinedCost / virtualCost));
+    }
+
+} // namespace
+
+int main( int argc, char **argv )
+{
+    const char *name = argc > 2 ? argv[2] : "Pyro/Ball of Smoke";
+
+    TLFXTest::TestEffectsLibrary library;
+    if (!TLFX_CHECK(library.Load(TLFXTest::libraryFile)))
+        return TLFXTest::Finish("BenchDrawSprite");
+    TLFX::Effect* effect = library.GetEffect(name);
+    if (!TLFX_CHECK(effect != NULL))
+        return TLFXTest::Finish("BenchDrawSprite");
+
+    Measure(effect, name, false);
+    Measure(effect, name, true);
+
+    return TLFXTest::Finish("BenchDrawSprite");
+}
@@ -0,0 +1,141 @@
+/*
+ * BudgetGovernor::Adjust fed with synthetic costs: it has to back off while over the budget, hold the scale within the hysteresis
+ * and recover once the cost drops, at the rates and within the limits it is set to.
+ */
+
+#include "TestSupport.h"
+
+#include "TLFXBudgetGovernor.h"
+
+namespace
+{
+
+    // feed the same cost until the smoothed cost settles on it
+    float Settle( TLFX::BudgetGovernor& governor, float milliseconds, float pixels = 0 )
+    {
+        float scale = governor.GetScale();
+        for (int i = 0; i < 60; ++i)
+            scale = governor.Adjust(milliseconds, pixels);
+        return scale;
+    }
+
+    void CheckOff()
+    {
+        TLFX::BudgetGovernor governor;
+        TLFX_CHECK(!governor.IsEnabled());
+        TLFX_CHECK(governor.Adjust(1000.0f, 1e9f) == 1.0f);
+        TLFX_CHECK(governor.GetReason() == TLFX::BudgetGovernor::reasonOff);
+    }
+
+    void CheckBackOff()
+    {
+        TLFX::BudgetGovernor governor;
+        governor.SetTargetTime(10.0f);
+        TLFX_CHECK(Settle(governor, 10.0f) == 1.0f);
+        TLFX_CHECK(governor.GetReason() == TLFX::BudgetGovernor::reasonWithinBudget);
+
+        // twice the budget: the scale goes down every update, by no more than the decrease
+        float scale = governor.GetScale();
+        bool cut = false;
+        for (int i = 0; i < 30; ++i)
+        {
+            float next = governor.Adjust(20.0f, 0);
+            TLFX_CHECK(next <= scale);
+            TLFX_CHECK(next >= scale * (1.0f - governor.GetDecrease()) - 1e-6f);
+            if (next < scale)
+            {
+                cut = true;
+                TLFX_CHECK(governor.GetReason() == TLFX::BudgetGovernor::reasonOverTime);
+            }
+            scale = next;
+        }
+        TLFX_CHECK(cut);
+        TLFX_CHECK(scale < 1.0f);
+
+        // it never goes below the minimum
+        TLFX_CHECK(Settle(governor, 1000.0f) >= governor.GetMinimumScale());
+        for (int i = 0; i < 200; ++i)
+            governor.Adjust(1000.0f, 0);
+        TLFX_CHECK(governor.GetScale() == governor.GetMinimumScale());
+        TLFX_CHECK(governor.GetReason() == TLFX::BudgetGovernor::reasonAtMinimum);
+    }
+
+    void CheckSmoothing()
+    {
+        TLFX::BudgetGovernor governor;
+        governor.SetTargetTime(10.0f);
+        Settle(governor, 10.0f);
+
+        // a single hitch is smoothed out and doesn't cut the scale
+        TLFX_CHECK(governor.Adjust(13.0f, 0) == 1.0f);
+        TLFX_CHECK(governor.GetReason() == TLFX::BudgetGovernor::reasonWithinBudget);
+    }
+
+    void CheckHold()
+    {
+        TLFX::BudgetGovernor governor;
+        governor.SetTargetTime(10.0f);
+        Settle(governor, 20.0f);
+        float held = Settle(governor, 10.5f);
+        TLFX_CHECK(held < 1.0f);
+
+        // costs moving around within 10% of the budget keep the scale where it is
+        for (int i = 0; i < 200; ++i)
+        {
+            TLFX_CHECK(governor.Adjust((i & 1) ? 9.5f : 10.5f, 0) == held);
+            TLFX_CHECK(governor.GetReason() == TLFX::BudgetGovernor::reasonWithinBudget);
+        }
+    }
+
+    void CheckRecovery()
+    {
+        TLFX::BudgetGovernor governor;
+        governor.SetTargetTime(10.0f);
+        Settle(governor, 20.0f);
+
+        // half the budget: the scale comes back by the increase per update, up to the maximum and no further
+        float scale = Settle(governor, 5.0f);
+        int updates = 0;
+        while (scale < governor.GetMaximumScale() && updates < 10000)
+        {
+            float next = governor.Adjust(5.0f, 0);
+            TLFX_CHECK(next > scale);
+            TLFX_CHECK(next <= scale * (1.0f + governor.GetIncrease()) + 1e-6f);
+            TLFX_CHECK(governor.GetReason() == TLFX::BudgetGovernor::reasonRecovering);
+            scale = next;
+            ++updates;
+        }
+        TLFX_CHECK(updates > 0);
+        TLFX_CHECK(scale == governor.GetMaximumScale());
+        TLFX_CHECK(governor.Adjust(5.0f, 0) == governor.GetMaximumScale());
+        TLFX_CHECK(governor.GetReason() == TLFX::BudgetGovernor::reasonWithinBudget);
+    }
+
+    void CheckPixels()
+    {
+        TLFX::BudgetGovernor governor;
+        governor.SetTargetTime(10.0f);
+        governor.SetPixelBudget(1000000.0f);
+
+        // the larger of the two loads decides
+        TLFX_CHECK(Settle(governor, 5.0f, 3000000.0f) < 1.0f);
+        TLFX_CHECK(governor.GetReason() == TLFX::BudgetGovernor::reasonOverPixels);
+
+        governor.Reset();
+        TLFX_CHECK(governor.GetScale() == governor.GetMaximumScale());
+        TLFX_CHECK(governor.GetReason() == TLFX::BudgetGovernor::reasonWithinBudget);
+    }
+
+} // namespace
+
+int main( int /*argc*/, char ** /*argv*/ )
+{
+    CheckOff();
+    CheckBackOff();
+    CheckSmoothing();
+    CheckHold();
+    CheckRecovery();
+    CheckPixels();
+
+    return TLFXTest::Finish("TestBudgetGovernor");
+}
@@ -0,0 +1,133 @@
+/*
+ * Frames of sample effects rasterized by the software integration, from the PNG shapes of the sample, have to match the golden images
+ * in the test data. Small differences are allowed, other compilers and instruction sets may round the floats differently.
+ *
+ * After an intended change to the rendering, write new golden images with TLFX_WRITE_GOLDEN=1 make check and look at them.
+ */
+
+#include "TestSupport.h"
+
+#include "TLFXSoftwareEffectsLibrary.h"
+#include "TLFXEffect.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+
+    class GoldenImage : public TLFX::SoftwareImage
+    {
+    public:
+        bool Read(const std::string& filename, std::vector<unsigned char>& rgba, int& width, int& height)
+        {
+            return Decode(filename.c_str(), rgba, width, height);
+        }
+    };
+
+    struct Frame
+    {
+        const char *effect;
+        const char *golden;
+        int updates;
+    };
+
+    const int frameSize = 128;
+    const int tolerance = 3;                        // per channel, out of 255
+    const double differentPixels = 0.005;           // share of the pixels that may differ by more
+
+    // every shape of the library has to decode, the library drops the shapes that don't and can't load the effects using them
+    bool CheckShapes()
+    {
+        TLFXTest::TestEffectsLibrary library;
+        if (!TLFX_CHECK(library.Load(TLFXTest::libraryFile)))
+            return false;
+
+        const auto& shapes = library.GetShapes();
+        bool decoded = TLFX_CHECK(!shapes.empty());
+        for (auto it = shapes.begin(); it != shapes.end(); ++it)
+        {
+            std::vector<unsigned char> rgba;
+            int width, height;
+            if (!TLFX_CHECK(GoldenImage().Read((*it)->GetFilename(), rgba, width, height)))
+            {
+                printf("shape not decoded: %s\n", (*it)->GetFilename());
+                decoded = false;
+            }
+        }
+        return decoded;
+    }
+
+    void CheckFrame( TLFX::EffectsLibrary& library, const Frame& frame, const std::string& golden )
+    {
+        TLFX::Effect *effect = library.GetEffect(frame.effect);
+        if (!TLFX_CHECK(effect != NULL))
+            return;
+
+        srand(1);
+        TLFX::SoftwareParticleManager pm;
+        pm.SetFramebufferSize(frameSize, frameSize);
+        pm.SetScreenSize(frameSize, frameSize);
+        pm.AddEffect(new TLFX::Effect(*effect, &pm));
+        for (int i = 0; i < frame.updates; ++i)
+            pm.Update();
+        pm.Clear();
+        pm.DrawParticles();
+        pm.Flush();
+
+        if (getenv("TLFX_WRITE_GOLDEN"))
+        {
+            TLFX_CHECK(pm.SaveImage(golden.c_str()));
+            printf("%s: written to %s\n", frame.effect, golden.c_str());
+            return;
+        }
+
+        std::vector<unsigned char> actual(frameSize * frameSize * 4);
+        pm.ReadPixels(&actual[0]);
+
+        std::vector<unsigned char> expected;
+        int width, height;
+        if (!TLFX_CHECK(GoldenImage().Read(golden, expected, width, height)) || !TLFX_CHECK(width == frameSize && height == frameSize))
+            return;
+
+        int different = 0, covered = 0, largest = 0;
+        for (size_t i = 0; i < actual.size(); i += 4)
+        {
+            int difference = 0;
+            for (int c = 0; c < 4; ++c)
+                difference = std::max(difference, abs(actual[i + c] - expected[i + c]));
+            largest = std::max(largest, difference);
+            if (difference > tolerance)
+                ++different;
+            if (expected[i] || expected[i + 1] || expected[i + 2] || expected[i + 3])
+                ++covered;                          // additive particles leave alpha at 0
+        }
+
+        // an empty golden image would pass whatever is drawn
+        TLFX_CHECK(covered > frameSize * frameSize / 20);
+        TLFX_CHECK(different <= frameSize * frameSize * differentPixels);
+        printf("%s: %d pixels covered, %d differ, by up to %d\n", frame.effect, covered, different, largest);
+    }
+
+} // namespace
+
+int main( int argc, char **argv )
+{
+    if (!CheckShapes())
+        return TLFXTest::Finish("TestSoftwareRender");
+
+    TLFX::SoftwareEffectsLibrary library;
+    if (!TLFX_CHECK(library.Load(TLFXTest::libraryFile)))
+        return TLFXTest::Finish("TestSoftwareRender");
+
+    const Frame frames[] =
+    {
+        { "Pyro/Fireball thick Smoke", "FireballThickSmoke.tga", 60 },      // alpha blended smoke and additive fire
+        { "Sub Effects/Spiro Graph", "SpiroGraph.tga", 120 },               // additive, drawn by sub effects
+    };
+    for (size_t i = 0; i < sizeof(frames) / sizeof(frames[0]); ++i)
+        CheckFrame(library, frames[i], TLFXTest::DataPath(argc, argv, frames[i].golden));
+
+    return TLFXTest::Finish("TestSoftwareRender");
+}
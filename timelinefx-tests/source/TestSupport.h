@@ -0,0 +1,91 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+/*
+ * Shared by the checks and benchmarks, see the Makefile
+ * Every program runs in the data directory of the sample, gets the directory of the test data as its first argument, prints the
+ * checks that fail and returns non zero if any did.
+ */
+
+#ifndef _TLFX_TESTSUPPORT_H
+#define _TLFX_TESTSUPPORT_H
+
+#include "TLFXEffectsLibrary.h"
+#include "TLFXPugiXMLLoader.h"
+#include "TLFXAnimImage.h"
+
+#include <cstdio>
+#include <map>
+#include <string>
+
+#define TLFX_CHECK(condition) \
+    TLFXTest::Check((condition), #condition, __FILE__, __LINE__)
+
+namespace TLFXTest
+{
+
+    inline int& Failures()
+    {
+        static int failures = 0;
+        return failures;
+    }
+
+    inline bool Check( bool passed, const char *condition, const char *file, int line )
+    {
+        if (!passed)
+        {
+            printf("%s:%d: check failed: %s\n", file, line, condition);
+            ++Failures();
+        }
+        return passed;
+    }
+
+    /**
+     * Print the outcome of the program and get its exit code
+     */
+    inline int Finish( const char *name )
+    {
+        if (Failures())
+            printf("%s: %d checks failed\n", name, Failures());
+        else
+            printf("%s: passed\n", name);
+        return Failures() ? 1 : 0;
+    }
+
+    /**
+     * The directory of the test data, passed in by the Makefile
+     */
+    inline std::string DataPath( int argc, char **argv, const char *filename )
+    {
+        std::string path = argc > 1 ? argv[1] : ".";
+        return path + "/" + filename;
+    }
+
+    // shapes without pixels, for checks that don't rasterize
+    class NullImage : public TLFX::AnimImage
+    {
+    public:
+        virtual bool Load(const char * /*filename*/)    { return true; }
+    };
+
+    class TestEffectsLibrary : public TLFX::EffectsLibrary
+    {
+    public:
+        virtual TLFX::XMLLoader* CreateLoader() const   { return new TLFX::PugiXMLLoader(0); }
+        virtual TLFX::AnimImage* CreateImage() const    { return new NullImage(); }
+
+        const std::map<std::string, TLFX::Effect*>& GetEffects() const  { return _effects; }
+        const std::map<std::string, TLFX::Emitter*>& GetEmitters() const    { return _emitters; }
+
+        /**
+         * Check if the effect is at the top of the library, not a sub effect of another one
+         */
+        static bool IsTopLevel(const std::string& path)  { return path.find('/') == path.rfind('/'); }
+    };
+
+    const char* const libraryFile = "particles/data.xml";
+
+} // namespace TLFXTest
+
+#endif // _TLFX_TESTSUPPORT_H
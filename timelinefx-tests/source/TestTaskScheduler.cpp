@@ -0,0 +1,111 @@
+/*
+ * Every effect of the sample updated and drawn with the serial and the threaded task scheduler has to give the same sprites, bit for
+ * bit: compiling while loading, the parallel particle update and the parallel snapshot capture may not change any result.
+ */
+
+#include "TestSupport.h"
+
+#include "TLFXParticleManager.h"
+#include "TLFXEffect.h"
+#include "TLFXTaskScheduler.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+
+    struct SpriteRecord
+    {
+        int shape;
+        float px, py, frame, x, y, rotation, scaleX, scaleY, a;
+        unsigned char r, g, b;
+        bool additive;
+
+        bool operator==(const SpriteRecord& o) const
+        {
+            return shape == o.shape && px == o.px && py == o.py && frame == o.frame && x == o.x && y == o.y && rotation == o.rotation
+                && scaleX == o.scaleX && scaleY == o.scaleY && a == o.a && r == o.r && g == o.g && b == o.b && additive == o.additive;
+        }
+    };
+
+    class RecordingParticleManager : public TLFX::ParticleManager
+    {
+    public:
+        RecordingParticleManager() : TLFX::ParticleManager(TLFX::ParticleManager::particleLimit, 1) {}
+
+        std::vector<SpriteRecord> records;
+
+    protected:
+        virtual void DrawSprite(TLFX::AnimImage* sprite, float px, float py, float frame, float x, float y, float rotation,
+            float scaleX, float scaleY, unsigned char r, unsigned char g, unsigned char b, float a, bool additive)
+        {
+            SpriteRecord record = { sprite->GetIndex(), px, py, frame, x, y, rotation, scaleX, scaleY, a, r, g, b, additive };
+            records.push_back(record);
+        }
+    };
+
+    const int updates = 90;
+
+    // the sprites of every top level effect, drawn after every update
+    std::vector<std::vector<SpriteRecord> > Run( TLFX::TaskScheduler* scheduler, bool pipelined )
+    {
+        TLFXTest::TestEffectsLibrary library;
+        library.SetTaskScheduler(scheduler);
+        std::vector<std::vector<SpriteRecord> > runs;
+        if (!TLFX_CHECK(library.Load(TLFXTest::libraryFile)))
+            return runs;
+
+        const auto& effects = library.GetEffects();
+        for (auto it = effects.begin(); it != effects.end(); ++it)
+        {
+            if (!TLFXTest::TestEffectsLibrary::IsTopLevel(it->first))
+                continue;
+
+            srand(1);
+            RecordingParticleManager pm;
+            pm.SetTaskScheduler(scheduler);
+            pm.SetParallelUpdateThreshold(1);       // every emitter takes the parallel path when there are workers
+            pm.SetPipelined(pipelined);
+            pm.SetScreenSize(800, 600);
+
+            TLFX::Effect *effect = new TLFX::Effect(*it->second, &pm);
+            pm.AddEffect(effect);
+            for (int i = 0; i < updates; ++i)
+            {
+                pm.Update();
+                pm.DrawParticles(0.5f);
+            }
+            runs.push_back(pm.records);
+        }
+        return runs;
+    }
+
+} // namespace
+
+int main( int /*argc*/, char ** /*argv*/ )
+{
+    TLFX::SerialTaskScheduler serial;
+    TLFX::ThreadTaskScheduler threads(3);
+    TLFX_CHECK(threads.GetWorkerCount() == 4);
+
+    for (int pipelined = 0; pipelined < 2; ++pipelined)
+    {
+        std::vector<std::vector<SpriteRecord> > expected = Run(&serial, pipelined != 0);
+        std::vector<std::vector<SpriteRecord> > actual = Run(&threads, pipelined != 0);
+
+        TLFX_CHECK(!expected.empty());
+        TLFX_CHECK(expected.size() == actual.size());
+        size_t sprites = 0;
+        for (size_t i = 0; i < expected.size() && i < actual.size(); ++i)
+        {
+            TLFX_CHECK(expected[i] == actual[i]);
+            sprites += expected[i].size();
+        }
+        TLFX_CHECK(sprites > 0);
+        printf("%s: %d effects, %d sprites\n", pipelined ? "pipelined" : "live", (int)expected.size(), (int)sprites);
+    }
+
+    return TLFXTest::Finish("TestTaskScheduler");
+}
@@ -1,8 +1,110 @@
 #include "TLFXAnimImage.h"
+#include "TLFXEffectsLibrary.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 
 namespace TLFX
 {
 
+    static const Vector2 fullQuad[4] = { Vector2(0, 0), Vector2(1, 0), Vector2(1, 1), Vector2(0, 1) };
+
+    // twice the area of the triangle o a b, positive when the points turn clockwise on the screen
+    static double Cross(const Vector2& o, const Vector2& a, const Vector2& b)
+    {
+        return (double)(a.x - o.x) * (b.y - o.y) - (double)(a.y - o.y) * (b.x - o.x);
+    }
+
+    // monotone chain, clockwise on the screen without collinear points
+    static std::vector<Vector2> ConvexHull(std::vector<Vector2>& points)
+    {
+        std::sort(points.begin(), points.end(), [](const Vector2& a, const Vector2& b)
+        {
+            return a.x < b.x || (a.x == b.x && a.y < b.y);
+        });
+
+        std::vector<Vector2> hull(points.size() * 2);
+        int k = 0;
+        for (int i = 0; i < (int)points.size(); ++i)
+        {
+            while (k >= 2 && Cross(hull[k - 2], hull[k - 1], points[i]) <= 0)
+                --k;
+            hull[k++] = points[i];
+        }
+        for (int i = (int)points.size() - 2, upper = k + 1; i >= 0; --i)
+        {
+            while (k >= upper && Cross(hull[k - 2], hull[k - 1], points[i]) <= 0)
+                --k;
+            hull[k++] = points[i];
+        }
+        hull.resize(k > 1 ? k - 1 : k);
+        return hull;
+    }
+
+    // cuts the edge that adds the least area by extending its neighbours until they meet, so the hull keeps covering everything
+    static void SimplifyHull(std::vector<Vector2>& hull, int vertices, float width, float height)
+    {
+        const float epsilon = 0.001f;
+
+        while ((int)hull.size() > vertices)
+        {
+            int n = (int)hull.size(), best = -1;
+            double bestArea = 0;
+            Vector2 bestPoint;
+            for (int i = 0; i < n; ++i)
+            {
+                const Vector2& a = hull[(i + n - 1) % n];
+                const Vector2& b = hull[i];
+                const Vector2& c = hull[(i + 1) % n];
+                const Vector2& d = hull[(i + 2) % n];
+
+                // b + s * (b - a) = c + t * (c - d) for s, t >= 0
+                double ex = b.x - a.x, ey = b.y - a.y, fx = c.x - d.x, fy = c.y - d.y, gx = c.x - b.x, gy = c.y - b.y;
+                double det = fx * ey - ex * fy;
+                if (det == 0)
+                    continue;
+                double s = (fx * gy - gx * fy) / det, t = (ex * gy - ey * gx) / det;
+                if (s < 0 || t < 0)
+                    continue;
+
+                Vector2 p((float)(b.x + s * ex), (float)(b.y + s * ey));
+                if (p.x < -epsilon || p.y < -epsilon || p.x > width + epsilon || p.y > height + epsilon)
+                    continue;
+
+                double area = fabs(Cross(b, p, c));
+                if (best < 0 || area < bestArea)
+                {
+                    best = i;
+                    bestArea = area;
+                    bestPoint = Vector2(std::min(std::max(p.x, 0.0f), width), std::min(std::max(p.y, 0.0f), height));
+                }
+            }
+
+            if (best < 0)
+            {
+                // no corner can be cut inside the frame, the bounding box always fits
+                float left = width, top = height, right = 0, bottom = 0;
+                for (auto it = hull.begin(); it != hull.end(); ++it)
+                {
+                    left = std::min(left, it->x);
+                    top = std::min(top, it->y);
+                    right = std::max(right, it->x);
+                    bottom = std::max(bottom, it->y);
+                }
+                hull.clear();
+                hull.push_back(Vector2(left, top));
+                hull.push_back(Vector2(right, top));
+                hull.push_back(Vector2(right, bottom));
+                hull.push_back(Vector2(left, bottom));
+                return;
+            }
+
+            hull[best] = bestPoint;
+            hull.erase(hull.begin() + (best + 1) % n);
+        }
+    }
+
 
     AnimImage::AnimImage()
         : _width(0)
@@ -10,6 +112,9 @@ namespace TLFX
         , _maxRadius(0)
         , _index(0)
         , _frames(1)
+        , _textureWidth(0)
+        , _textureHeight(0)
+        , _atlasPage(-1)
     {
 
     }
@@ -84,4 +189,194 @@ namespace TLFX
         return _name.c_str();
     }
 
+    void AnimImage::SetTextureSize( int width, int height )
+    {
+        _textureWidth = width;
+        _textureHeight = height;
+    }
+
+    int AnimImage::GetTextureWidth() const
+    {
+        return _textureWidth;
+    }
+
+    int AnimImage::GetTextureHeight() const
+    {
+        return _textureHeight;
+    }
+
+    void AnimImage::GetFrameSource( int frame, int& x, int& y ) const
+    {
+        int columns = _width > 0 && _textureWidth > 0 ? _textureWidth / (int)_width : 0;
+        if (columns <= 0)
+        {
+            x = y = 0;
+            return;
+        }
+
+        frame = WrapFrame(frame);
+        x = (frame % columns) * (int)_width;
+        y = (frame / columns) * (int)_height;
+    }
+
+    void AnimImage::SetAtlasFrame( int frame, int page, int x, int y, int pageWidth, int pageHeight )
+    {
+        assert(frame >= 0 && frame < GetFramesCount());
+        assert(_atlasPage < 0 || _atlasPage == page);   // all frames go on the same page, so the image draws from one texture
+
+        if ((int)_atlasFrames.size() < GetFramesCount())
+            _atlasFrames.resize(GetFramesCount());
+        _atlasPage = page;
+
+        Frame& f = _atlasFrames[frame];
+        f.x = x;
+        f.y = y;
+        f.u0 = (float)x / pageWidth;
+        f.v0 = (float)y / pageHeight;
+        f.u1 = (x + _width) / pageWidth;
+        f.v1 = (y + _height) / pageHeight;
+    }
+
+    void AnimImage::ClearAtlas()
+    {
+        _atlasPage = -1;
+        std::vector<Frame>().swap(_atlasFrames);
+    }
+
+    int AnimImage::GetAtlasPage() const
+    {
+        return _atlasPage;
+    }
+
+    void AnimImage::GetAtlasFramePosition( int frame, int& x, int& y ) const
+    {
+        assert(_atlasPage >= 0);
+
+        const Frame& f = _atlasFrames[WrapFrame(frame)];
+        x = f.x;
+        y = f.y;
+    }
+
+    void AnimImage::GetFrameUV( int frame, float& u0, float& v0, float& u1, float& v1 ) const
+    {
+        if (_atlasPage >= 0)
+        {
+            const Frame& f = _atlasFrames[WrapFrame(frame)];
+            u0 = f.u0;
+            v0 = f.v0;
+            u1 = f.u1;
+            v1 = f.v1;
+        }
+        else if (_textureWidth > 0 && _textureHeight > 0)
+        {
+            int x, y;
+            GetFrameSource(frame, x, y);
+            u0 = (float)x / _textureWidth;
+            v0 = (float)y / _textureHeight;
+            u1 = (x + _width) / _textureWidth;
+            v1 = (y + _height) / _textureHeight;
+        }
+        else
+        {
+            u0 = v0 = 0;
+            u1 = v1 = 1.0f;
+        }
+    }
+
+    bool AnimImage::BuildHulls( const unsigned char *alpha, int pixelStride, int rowStride, int threshold, int vertices /*= maxHullVertices*/ )
+    {
+        assert(alpha && vertices >= 4 && vertices <= maxHullVertices);
+
+        ClearHulls();
+
+        int width = (int)_width, height = (int)_height;
+        int frames = std::max(GetFramesCount(), 1);
+        if (width <= 0 || height <= 0)
+            return false;
+
+        std::vector<std::vector<Vector2> > hulls(frames);
+        std::vector<Vector2> points;
+        float radius = 0;
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            int x, y;
+            GetFrameSource(frame, x, y);
+            if (x + width > _textureWidth || y + height > _textureHeight)
+            {
+                TLFXLOG(EFFECTS, ("frames of %s don't fit in the image", GetName()));
+                return false;
+            }
+
+            // the first and last pixel of every row are enough for the hull, grown by half a pixel so bilinear filtering around them is kept
+            points.clear();
+            for (int row = 0; row < height; ++row)
+            {
+                const unsigned char *pixels = alpha + (y + row) * rowStride + x * pixelStride;
+                int left = 0, right = width - 1;
+                while (left < width && pixels[left * pixelStride] <= threshold)
+                    ++left;
+                if (left == width)
+                    continue;
+                while (pixels[right * pixelStride] <= threshold)
+                    --right;
+
+                float x0 = std::max(left - 0.5f, 0.0f), x1 = std::min(right + 1.5f, (float)width);
+                float y0 = std::max(row - 0.5f, 0.0f), y1 = std::min(row + 1.5f, (float)height);
+                Vector2 corners[4] = { Vector2(x0, y0), Vector2(x0, y1), Vector2(x1, y0), Vector2(x1, y1) };
+                for (int i = 0; i < 4; ++i)
+                {
+                    points.push_back(corners[i]);
+                    radius = std::max(radius, Vector2::GetDistance(width / 2.0f, height / 2.0f, corners[i].x, corners[i].y));
+                }
+            }
+
+            if (points.empty())
+                continue;                           // nothing to draw
+
+            std::vector<Vector2> hull = ConvexHull(points);
+            SimplifyHull(hull, vertices, (float)width, (float)height);
+            for (auto it = hull.begin(); it != hull.end(); ++it)
+            {
+                it->x /= width;
+                it->y /= height;
+            }
+            hulls[frame].swap(hull);
+        }
+
+        _hulls.swap(hulls);
+        if (_maxRadius == 0)
+            _maxRadius = radius;
+        return true;
+    }
+
+    void AnimImage::ClearHulls()
+    {
+        _hulls.clear();
+    }
+
+    bool AnimImage::IsTrimmed() const
+    {
+        return !_hulls.empty();
+    }
+
+    int AnimImage::GetFrameHull( int frame, const Vector2*& points ) const
+    {
+        if (_hulls.empty())
+        {
+            points = fullQuad;
+            return 4;
+        }
+
+        const std::vector<Vector2>& hull = _hulls[WrapFrame(frame)];
+        points = hull.empty() ? NULL : &hull[0];
+        return (int)hull.size();
+    }
+
+    int AnimImage::WrapFrame( int frame ) const
+    {
+        int frames = GetFramesCount() > 0 ? GetFramesCount() : 1;
+        frame %= frames;
+        return frame < 0 ? frame + frames : frame;
+    }
+
 } // namespace TLFX
@@ -5,7 +5,10 @@
 #ifndef _TLFX_ANIMIMAGE_H
 #define _TLFX_ANIMIMAGE_H
 
+#include "TLFXVector2.h"
+
 #include <string>
+#include <vector>
 
 namespace TLFX
 {
@@ -13,6 +16,8 @@ namespace TLFX
     class AnimImage
     {
     public:
+        enum { maxHullVertices = 8 };
+
         AnimImage();
         virtual ~AnimImage() {}
 
@@ -35,7 +40,80 @@ namespace TLFX
 
         virtual void        FindRadius() {}
 
+        /**
+         * Set the size of the loaded image file
+         * <p>Animation frames of #GetWidth x #GetHeight are laid out in rows over the image, left to right and top to bottom. Integrations
+         * set the size when loading the image, so #GetFrameUV can find the frames. Without it the whole image is taken as a single frame.</p>
+         */
+        void                SetTextureSize(int width, int height);
+        int                 GetTextureWidth() const;
+        int                 GetTextureHeight() const;
+
+        /**
+         * Get the pixel position of a frame in the image file
+         */
+        void                GetFrameSource(int frame, int& x, int& y) const;
+
+        /**
+         * Place a frame on an atlas page, see EffectsLibrary::BuildAtlas
+         */
+        void                SetAtlasFrame(int frame, int page, int x, int y, int pageWidth, int pageHeight);
+        void                ClearAtlas();
+
+        /**
+         * Get the atlas page the frames are on
+         * @return -1 if the image isn't in the atlas and is drawn from its own texture
+         */
+        int                 GetAtlasPage() const;
+
+        /**
+         * Get the pixel position of a frame on its atlas page
+         */
+        void                GetAtlasFramePosition(int frame, int& x, int& y) const;
+
+        /**
+         * Get the texture coordinates of a frame
+         * On the atlas page if the image is in the atlas, otherwise in the image's own texture. The frame wraps around #GetFramesCount.
+         */
+        void                GetFrameUV(int frame, float& u0, float& v0, float& u1, float& v1) const;
+
+        /**
+         * Trim every frame to the outline of its pixels with alpha above threshold, see #BuildHulls
+         * <p>Called by EffectsLibrary::TrimShapes once the image is loaded. Only integrations can read the pixels, so the default does
+         * nothing and returns false, override it to pass the alpha channel to #BuildHulls.</p>
+         */
+        virtual bool        Trim(int /*threshold*/, int /*vertices*/) { return false; }
+
+        /**
+         * Find the convex outline of the pixels with alpha above threshold in every frame
+         * <p>Large soft particles like smoke and glows are transparent in most of their quad, but the GPU still blends every pixel of it.
+         * Drawing the outline from #GetFrameHull instead skips those pixels. The outline of every frame is the convex hull of its pixels,
+         * simplified to at most vertices points by cutting corners so it still covers every pixel and stays inside the frame.</p>
+         * <p>The maximum radius is set from the pixels too, unless the library file gave one, see #GetMaxRadius.</p>
+         * @param alpha The alpha of the top left pixel of the image, the next pixel is pixelStride bytes further and the next row rowStride
+         * @param vertices From 4 to #maxHullVertices
+         * @return false if the frames don't fit in the image, see #SetTextureSize
+         */
+        bool                BuildHulls(const unsigned char *alpha, int pixelStride, int rowStride, int threshold, int vertices = maxHullVertices);
+        void                ClearHulls();
+        bool                IsTrimmed() const;
+
+        /**
+         * Get the outline of a frame, see #BuildHulls
+         * <p>The points are from 0 to 1 across the width and height of the frame, in clockwise order on the screen with the first one
+         * shared by a fan of triangles covering the outline. Untrimmed frames are the 4 corners of the quad, and frames without a visible
+         * pixel have no points. ParticleManager::GetSpriteEdges places the points on the screen.</p>
+         * @return The number of points
+         */
+        int                 GetFrameHull(int frame, const Vector2*& points) const;
+
     protected:
+        struct Frame
+        {
+            int x, y;                               // on the atlas page
+            float u0, v0, u1, v1;
+        };
+
         float _width;
         float _height;
         float _maxRadius;
@@ -43,6 +121,13 @@ namespace TLFX
         int _frames;
         std::string _filename;
         std::string _name;
+        int _textureWidth;
+        int _textureHeight;
+        int _atlasPage;
+        std::vector<Frame> _atlasFrames;
+        std::vector<std::vector<Vector2> > _hulls;  // one per frame when trimmed
+
+        int WrapFrame(int frame) const;
     };
 
 } // namespace TLFX
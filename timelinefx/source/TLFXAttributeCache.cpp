@@ -0,0 +1,111 @@
+#include "TLFXAttributeCache.h"
+
+#include <cassert>
+#include <cstddef>
+
+namespace TLFX
+{
+
+    AttributeCache::AttributeCache()
+        : _buckets(NULL)
+        , _values(NULL)
+        , _bucketCount(0)
+        , _valueCount(0)
+    {
+
+    }
+
+    AttributeCache::~AttributeCache()
+    {
+        Free();
+    }
+
+    void AttributeCache::Reset( int valueCount, int bucketCount /*= defaultBucketCount*/ )
+    {
+        assert(valueCount > 0 && bucketCount >= 0);
+
+        if (bucketCount != _bucketCount || valueCount != _valueCount)
+        {
+            Free();
+            if (bucketCount > 0)
+            {
+                _buckets = new Bucket[bucketCount];
+                _values = new std::atomic<float>[bucketCount * valueCount];
+                _bucketCount = bucketCount;
+                _valueCount = valueCount;
+            }
+        }
+
+        for (int i = 0; i < _bucketCount; ++i)
+        {
+            _buckets[i].sequence.store(0, std::memory_order_relaxed);
+            _buckets[i].frame.store(-1.0f, std::memory_order_relaxed);
+        }
+    }
+
+    bool AttributeCache::Get( float frame, float* values ) const
+    {
+        if (!_buckets || !(frame >= 0))
+            return false;
+
+        int index = (int)((unsigned int)frame % (unsigned int)_bucketCount);
+        const Bucket& bucket = _buckets[index];
+        unsigned int sequence = bucket.sequence.load(std::memory_order_acquire);
+        if ((sequence & 1) || bucket.frame.load(std::memory_order_relaxed) != frame)
+            return false;
+
+        const std::atomic<float>* stored = _values + index * _valueCount;
+        for (int i = 0; i < _valueCount; ++i)
+            values[i] = stored[i].load(std::memory_order_relaxed);
+
+        // the values are only good if no store started meanwhile
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return bucket.sequence.load(std::memory_order_relaxed) == sequence;
+    }
+
+    void AttributeCache::Set( float frame, const float* values )
+    {
+        if (!_buckets || !(frame >= 0))
+            return;
+
+        int index = (int)((unsigned int)frame % (unsigned int)_bucketCount);
+        Bucket& bucket = _buckets[index];
+        unsigned int sequence = bucket.sequence.load(std::memory_order_relaxed);
+        if ((sequence & 1) || !bucket.sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_relaxed))
+            return;                                 // another thread is storing into this bucket, let it
+        std::atomic_thread_fence(std::memory_order_release);
+
+        std::atomic<float>* stored = _values + index * _valueCount;
+        for (int i = 0; i < _valueCount; ++i)
+            stored[i].store(values[i], std::memory_order_relaxed);
+        bucket.frame.store(frame, std::memory_order_relaxed);
+
+        bucket.sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    bool AttributeCache::IsEnabled() const
+    {
+        return _buckets != NULL;
+    }
+
+    int AttributeCache::GetValueCount() const
+    {
+        return _valueCount;
+    }
+
+    int AttributeCache::GetBucketCount() const
+    {
+        return _bucketCount;
+    }
+
+    void AttributeCache::Free()
+    {
+        delete[] _buckets;
+        delete[] _values;
+        _buckets = NULL;
+        _values = NULL;
+        _bucketCount = 0;
+        _valueCount = 0;
+    }
+
+} // namespace TLFX
@@ -0,0 +1,70 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_ATTRIBUTECACHE_H
+#define _TLFX_ATTRIBUTECACHE_H
+
+#include <atomic>
+
+namespace TLFX
+{
+
+    /**
+     * Attribute Cache type
+     * <p>Values of a fixed set of attributes at recently used frames. A library effect or emitter keeps one for all its instances, so
+     * instances at the same frame, like many copies of an effect spawned on the same update, look their attributes up once between them.</p>
+     * <p>Frames map to a fixed number of buckets by their integer part, each bucket remembers the last frame stored in it. A value is only
+     * returned for exactly the frame it was stored for, so the cache never changes results. #Get and #Set can be called from any thread,
+     * a lookup that races with a store simply misses.</p>
+     */
+    class AttributeCache
+    {
+    public:
+        enum { defaultBucketCount = 32 };
+
+        AttributeCache();
+        ~AttributeCache();
+
+        /**
+         * Allocate the buckets for valueCount attributes and forget all stored values
+         * Not thread safe, only call while no instance is being updated. A bucketCount of 0 turns the cache off.
+         */
+        void Reset(int valueCount, int bucketCount = defaultBucketCount);
+
+        /**
+         * Get the values stored for frame
+         * @return false if they aren't cached
+         */
+        bool Get(float frame, float* values) const;
+
+        /**
+         * Store the values of frame, replacing what its bucket held
+         */
+        void Set(float frame, const float* values);
+
+        bool IsEnabled() const;
+        int GetValueCount() const;
+        int GetBucketCount() const;
+
+    protected:
+        struct Bucket
+        {
+            std::atomic<unsigned int>   sequence;       // odd while a value is being stored
+            std::atomic<float>          frame;          // -1 when empty
+        };
+
+        Bucket*                         _buckets;
+        std::atomic<float>*             _values;        // valueCount per bucket
+        int                             _bucketCount;
+        int                             _valueCount;
+
+        void Free();
+
+        AttributeCache(const AttributeCache&);
+        AttributeCache& operator=(const AttributeCache&);
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_ATTRIBUTECACHE_H
@@ -0,0 +1,355 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_BASICPARTICLEMANAGER_H
+#define _TLFX_BASICPARTICLEMANAGER_H
+
+#include "TLFXParticleManager.h"
+#include "TLFXEffect.h"
+#include "TLFXParticle.h"
+#include "TLFXAnimImage.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace TLFX
+{
+
+    /**
+     * Basic Particle Manager type
+     * <p>A #ParticleManager that calls the DrawSprite of the integration directly instead of through the virtual ParticleManager::DrawSprite,
+     * so the compiler can inline the batching code of the integration into the loop over the particles. Derive the integration from it,
+     * passing its own type, and let ParticleManager call its DrawSprite:</p>
+     * &{<pre>
+     * class MyParticleManager : public BasicParticleManager<MyParticleManager>
+     * {
+     *     friend class ParticleManager;
+     * protected:
+     *     virtual void DrawSprite(AnimImage* sprite, float px, float py, float frame, float x, float y, float rotation,
+     *         float scaleX, float scaleY, unsigned char r, unsigned char g, unsigned char b, float a, bool additive);
+     * };
+     * </pre>}
+     * <p>Everything else is inherited from ParticleManager, which keeps drawing through the virtual DrawSprite for integrations deriving
+     * from it directly. DrawSprite stays an override, so the manager can still be used through a ParticleManager pointer and
+     * ParticleManager::DrawParticles ends up in the inlined loop too.</p>
+     * <p>Only the DrawSprite of the class passed as Renderer is called. A class deriving from the integration in turn and overriding
+     * DrawSprite again is bypassed without any warning, so derive it from BasicParticleManager itself, passing its own type, or forward
+     * to a virtual function of your own from the DrawSprite of the integration.</p>
+     */
+    template <class Renderer>
+    class BasicParticleManager : public ParticleManager
+    {
+    public:
+        BasicParticleManager(int particles = ParticleManager::particleLimit, int layers = 1)
+            : ParticleManager(particles, layers)
+        {
+
+        }
+
+        using ParticleManager::DrawParticles;
+
+        virtual void DrawParticles(const View& view, float tween = 1.0f, int layer = -1)
+        {
+            DrawView(view, tween, layer, static_cast<Renderer&>(*this));
+        }
+    };
+
+    // the draw templates of ParticleManager, every particle visible in a view is passed to renderer.DrawSprite
+
+    template <class Renderer>
+    void ParticleManager::DrawView( const View& view, float tween, int layer, Renderer& renderer ) const
+    {
+        DrawState state;
+        bool governed = _governor.IsEnabled();
+        auto start = governed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+        state.countPixels = governed && _governor.GetPixelBudget() > 0;
+        state.pixels = 0;
+
+        TweenCamera(view, tween, state);
+
+        if (_pipelined)
+        {
+            const RenderSnapshot& snapshot = _snapshots[_snapshotRead];
+            if (snapshot.tick != 0)                 // 0 until the first snapshot is published
+                DrawSnapshot(state, snapshot, layer, renderer);
+        }
+        else
+        {
+            _drawCount.fetch_add(1, std::memory_order_relaxed);
+            DrawLayers(state, layer, renderer);
+        }
+
+        if (governed)
+        {
+            _drawPixels.fetch_add((long long)state.pixels, std::memory_order_relaxed);
+            _drawMicroseconds.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count(),
+                                        std::memory_order_relaxed);
+        }
+    }
+
+    template <class Renderer>
+    void ParticleManager::DrawLayers( DrawState& state, int layer, Renderer& renderer ) const
+    {
+        int layers = 0;
+        int startLayer = 0;
+        if (layer == -1 || layer >= _effectLayers)
+        {
+            layers = _effectLayers - 1;
+        }
+        else
+        {
+            layers = layer;
+            startLayer = layer;
+        }
+
+        for (int el = startLayer; el <= layers; ++el)
+        {
+            for (int i = 0; i < 10; ++i)
+            {
+                auto& plist = _inUse[el][i];
+                for (auto it = plist.begin(); it != plist.end(); ++it)
+                {
+                    DrawParticle(state, *it, renderer);
+                }
+            }
+        }
+
+        if (_drawListValid)
+        {
+            // flattened by Update, drawn without walking the effects
+            for (int el = 0; el < _effectLayers; ++el)
+            {
+                const auto& plist = _drawList[el];
+                for (auto it = plist.begin(); it != plist.end(); ++it)
+                {
+                    DrawParticle(state, *it, renderer);
+                }
+            }
+            return;
+        }
+
+        // not built by the last update, or particles or effects were added or removed since
+        std::vector<EffectWalkFrame> stack;
+        for (auto it = _effects.begin(); it != _effects.end(); ++it)
+        {
+            for (auto it2 = it->begin(); it2 != it->end(); ++it2)
+            {
+                DrawEffect(state, *it2, stack, renderer);
+            }
+        }
+    }
+
+    template <class Renderer>
+    void ParticleManager::DrawEffect( DrawState& state, Effect *e, std::vector<EffectWalkFrame>& stack, Renderer& renderer ) const
+    {
+        auto draw = [this, &state, &renderer](Particle *p) { DrawParticle(state, p, renderer); };
+        WalkEffect(e, draw, stack);
+    }
+
+    template <class Visitor>
+    void ParticleManager::WalkEffect( Effect *effect, Visitor& visit, std::vector<EffectWalkFrame>& stack )
+    {
+        // effects without sub effects are walked without looking at the children of their particles
+        if (!HasSubEffects(effect))
+        {
+            for (int i = 0; i < 10; ++i)
+            {
+                const auto& plist = effect->GetParticles(i);
+                for (auto it = plist.begin(); it != plist.end(); ++it)
+                {
+                    visit(*it);
+                }
+            }
+            return;
+        }
+
+        EffectWalkFrame frame;
+        frame.effect = effect;
+        frame.layer = 0;
+        frame.particle = effect->GetParticles(0).begin();
+        frame.inChildren = false;
+        stack.push_back(frame);
+
+        while (!stack.empty())
+        {
+            EffectWalkFrame& f = stack.back();
+            if (f.inChildren)
+            {
+                if (f.child != f.childEnd)
+                {
+                    Effect *child = static_cast<Effect*>(*f.child++);
+                    if (!HasSubEffects(child))
+                    {
+                        for (int i = 0; i < 10; ++i)
+                        {
+                            const auto& plist = child->GetParticles(i);
+                            for (auto it = plist.begin(); it != plist.end(); ++it)
+                            {
+                                visit(*it);
+                            }
+                        }
+                        continue;
+                    }
+                    frame.effect = child;
+                    frame.particle = child->GetParticles(0).begin();
+                    stack.push_back(frame);         // f is invalid from here
+                    continue;
+                }
+                f.inChildren = false;
+                ++f.particle;
+            }
+
+            while (f.particle == f.effect->GetParticles(f.layer).end())
+            {
+                if (++f.layer == 10)
+                    break;
+                f.particle = f.effect->GetParticles(f.layer).begin();
+            }
+            if (f.layer == 10)
+            {
+                stack.pop_back();
+                continue;
+            }
+
+            visit(*f.particle);
+            const auto& children = (*f.particle)->GetChildren();
+            f.child = children.begin();
+            f.childEnd = children.end();
+            f.inChildren = true;
+        }
+    }
+
+    template <class Renderer>
+    void ParticleManager::DrawParticle( DrawState& state, Particle *p, Renderer& renderer ) const
+    {
+        RenderParticle rp;
+        if (CaptureParticle(p, rp))
+            DrawRenderParticle(state, rp, renderer);
+    }
+
+    template <class Renderer>
+    void ParticleManager::DrawSnapshot( DrawState& state, const RenderSnapshot& snapshot, int layer, Renderer& renderer ) const
+    {
+        int layers = 0;
+        int startLayer = 0;
+        if (layer == -1 || layer >= _effectLayers)
+        {
+            layers = _effectLayers - 1;
+        }
+        else
+        {
+            layers = layer;
+            startLayer = layer;
+        }
+
+        for (int el = startLayer; el <= layers; ++el)
+        {
+            const auto& plist = snapshot.layerParticles[el];
+            for (auto it = plist.begin(); it != plist.end(); ++it)
+            {
+                DrawRenderParticle(state, *it, renderer);
+            }
+        }
+        for (int el = 0; el < _effectLayers; ++el)
+        {
+            const auto& plist = snapshot.effectParticles[el];
+            for (auto it = plist.begin(); it != plist.end(); ++it)
+            {
+                DrawRenderParticle(state, *it, renderer);
+            }
+        }
+    }
+
+    template <class Renderer>
+    void ParticleManager::DrawRenderParticle( DrawState& state, const RenderParticle& p, Renderer& renderer ) const
+    {
+        float tween = state.tween;
+        float px = TweenValues(p.oldWX, p.wx, tween);
+        float py = TweenValues(p.oldWY, p.wy, tween);
+
+        if (state.rotated)
+        {
+            Vector2 rotVec = state.matrix.TransformVector(Vector2(px, py));
+            px = (rotVec.x * state.camtz) + state.centerX + (state.camtz * state.camtx);
+            py = (rotVec.y * state.camtz) + state.centerY + (state.camtz * state.camty);
+        }
+        else
+        {
+            px = (px * state.camtz) + state.centerX + (state.camtz * state.camtx);
+            py = (py * state.camtz) + state.centerY + (state.camtz * state.camty);
+        }
+
+        if (px > state.vpX - p.imageDiameter && px < state.vpX + state.vpW + p.imageDiameter && py > state.vpY - p.imageDiameter && py < state.vpY + state.vpH + p.imageDiameter)
+        {
+            float rotation = TweenValues(p.oldAngle, p.angle, tween) + state.angle;
+
+            float scaleX, scaleY;
+
+            float tx = TweenValues(p.oldScaleX, p.scaleX, tween);
+            float ty = TweenValues(p.oldScaleY, p.scaleY, tween);
+            float tz = TweenValues(p.oldZ, p.z, tween);
+            if (tz != 1.0f)
+            {
+                //SetScale(tx * tz * camtz, ty * tz * camtz);
+                scaleX = tx * tz * state.camtz;
+                scaleY = ty * tz * state.camtz;
+            }
+            else
+            {
+                //SetScale(tx * camtz, ty * camtz);
+                scaleX = tx * state.camtz;
+                scaleY = ty * state.camtz;
+            }
+
+            float frame;
+            if (p.animating)
+            {
+                float frames = (float)p.sprite->GetFramesCount();
+                frame = TweenValues(p.oldFrame, p.frame, tween);
+                if (frame < 0)
+                {
+                    frame = frames + fmodf(frame, frames);
+                    if (frame == frames)
+                        frame = 0;
+                }
+                else
+                {
+                    frame = fmodf(frame, frames);
+                }
+            }
+            else
+            {
+                frame = p.frame;
+            }
+
+            unsigned char r = p.r, g = p.g, b = p.b;
+            float alpha = p.alpha;
+            bool additive = p.additive;
+            if (_premultipliedAlpha)
+            {
+                alpha = std::min(std::max(alpha, 0.0f), 1.0f);
+                if ((unsigned char)(alpha * 255) == 0)
+                    return;                         // invisible in either blend mode
+
+                r = (unsigned char)(r * alpha + 0.5f);
+                g = (unsigned char)(g * alpha + 0.5f);
+                b = (unsigned char)(b * alpha + 0.5f);
+                if (additive)
+                    alpha = 0;                      // adds its color, covers nothing
+                additive = false;
+            }
+
+            if (state.countPixels)
+                state.pixels += fabsf(p.sprite->GetWidth() * scaleX * p.sprite->GetHeight() * scaleY);
+
+            // qualified, so an overriding DrawSprite of a BasicParticleManager is called directly and can be inlined,
+            // which also skips overrides in classes deriving from Renderer, see BasicParticleManager
+            renderer.Renderer::DrawSprite(p.sprite, px, py, frame, p.handleX, p.handleY, rotation, scaleX, scaleY, r, g, b, alpha, additive);
+            // ++rendercount
+        }
+    }
+
+} // namespace TLFX
+
+#endif // _TLFX_BASICPARTICLEMANAGER_H
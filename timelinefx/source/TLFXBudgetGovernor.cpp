@@ -0,0 +1,187 @@
+#include "TLFXBudgetGovernor.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace TLFX
+{
+
+    BudgetGovernor::BudgetGovernor()
+        : _targetTime(0)
+        , _pixelBudget(0)
+        , _minimumScale(0.1f)
+        , _maximumScale(1.0f)
+        , _hysteresis(0.1f)
+        , _decrease(0.02f)
+        , _increase(0.005f)
+        , _scale(1.0f)
+        , _reason(reasonOff)
+        , _time(0)
+        , _pixels(0)
+        , _samples(0)
+    {
+
+    }
+
+    void BudgetGovernor::SetTargetTime( float milliseconds )
+    {
+        _targetTime = milliseconds;
+    }
+
+    float BudgetGovernor::GetTargetTime() const
+    {
+        return _targetTime;
+    }
+
+    void BudgetGovernor::SetPixelBudget( float pixels )
+    {
+        _pixelBudget = pixels;
+    }
+
+    float BudgetGovernor::GetPixelBudget() const
+    {
+        return _pixelBudget;
+    }
+
+    void BudgetGovernor::SetScaleLimits( float minimum, float maximum /*= 1.0f*/ )
+    {
+        assert(minimum > 0 && minimum <= maximum);
+
+        _minimumScale = minimum;
+        _maximumScale = maximum;
+        _scale = std::min(std::max(_scale, minimum), maximum);
+    }
+
+    float BudgetGovernor::GetMinimumScale() const
+    {
+        return _minimumScale;
+    }
+
+    float BudgetGovernor::GetMaximumScale() const
+    {
+        return _maximumScale;
+    }
+
+    void BudgetGovernor::SetHysteresis( float fraction )
+    {
+        _hysteresis = fraction;
+    }
+
+    float BudgetGovernor::GetHysteresis() const
+    {
+        return _hysteresis;
+    }
+
+    void BudgetGovernor::SetResponse( float decrease, float increase )
+    {
+        assert(decrease >= 0 && decrease < 1 && increase >= 0);
+
+        _decrease = decrease;
+        _increase = increase;
+    }
+
+    float BudgetGovernor::GetDecrease() const
+    {
+        return _decrease;
+    }
+
+    float BudgetGovernor::GetIncrease() const
+    {
+        return _increase;
+    }
+
+    bool BudgetGovernor::IsEnabled() const
+    {
+        return _targetTime > 0 || _pixelBudget > 0;
+    }
+
+    float BudgetGovernor::Adjust( float milliseconds, float pixels )
+    {
+        if (!IsEnabled())
+        {
+            Reset();
+            return _scale;
+        }
+
+        // a single slow frame, a page fault or a hitch elsewhere, shouldn't cut the particles
+        const float smoothing = 0.25f;
+        if (_samples++ == 0)
+        {
+            _time = milliseconds;
+            _pixels = pixels;
+        }
+        else
+        {
+            _time += (milliseconds - _time) * smoothing;
+            _pixels += (pixels - _pixels) * smoothing;
+        }
+
+        float timeLoad = _targetTime > 0 ? _time / _targetTime : 0;
+        float pixelLoad = _pixelBudget > 0 ? _pixels / _pixelBudget : 0;
+        float load = std::max(timeLoad, pixelLoad);
+
+        if (load > 1.0f + _hysteresis)
+        {
+            _scale = std::max(_scale * std::max(1.0f / load, 1.0f - _decrease), _minimumScale);
+            if (_scale <= _minimumScale)
+                _reason = reasonAtMinimum;
+            else
+                _reason = timeLoad >= pixelLoad ? reasonOverTime : reasonOverPixels;
+        }
+        else if (load < 1.0f - _hysteresis && _scale < _maximumScale)
+        {
+            _scale = std::min(_scale * (1.0f + _increase), _maximumScale);
+            _reason = reasonRecovering;
+        }
+        else
+        {
+            _reason = reasonWithinBudget;
+        }
+
+        return _scale;
+    }
+
+    void BudgetGovernor::Reset()
+    {
+        _scale = _maximumScale;
+        _reason = IsEnabled() ? reasonWithinBudget : reasonOff;
+        _time = 0;
+        _pixels = 0;
+        _samples = 0;
+    }
+
+    float BudgetGovernor::GetScale() const
+    {
+        return _scale;
+    }
+
+    BudgetGovernor::Reason BudgetGovernor::GetReason() const
+    {
+        return _reason;
+    }
+
+    const char* BudgetGovernor::GetReasonName( Reason reason )
+    {
+        switch (reason)
+        {
+        case reasonOff:             return "off";
+        case reasonWithinBudget:    return "within budget";
+        case reasonOverTime:        return "over time";
+        case reasonOverPixels:      return "over pixels";
+        case reasonRecovering:      return "recovering";
+        case reasonAtMinimum:       return "at minimum";
+        }
+        return "";
+    }
+
+    float BudgetGovernor::GetTime() const
+    {
+        return _time;
+    }
+
+    float BudgetGovernor::GetPixels() const
+    {
+        return _pixels;
+    }
+
+} // namespace TLFX
@@ -0,0 +1,118 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_BUDGETGOVERNOR_H
+#define _TLFX_BUDGETGOVERNOR_H
+
+namespace TLFX
+{
+
+    /**
+     * Budget Governor type
+     * <p>Holds the cost of a particle manager to a budget by scaling the amount of particles spawned, see ParticleManager::GetBudgetGovernor.
+     * Every update the particle manager passes in the time its last update and draws took, and optionally the pixels its sprites covered.
+     * Both are smoothed and compared to the budget:</p>
+     * <ul>
+     * <li>Over the budget by more than the hysteresis, the scale is cut in proportion to the overshoot, by no more than the decrease per
+     * update. Particles already alive keep costing for their whole life, so cutting harder would overshoot.</li>
+     * <li>Under the budget by more than the hysteresis, the scale slowly recovers by the increase per update, up to the maximum.</li>
+     * <li>Within the hysteresis the scale is held, so it doesn't oscillate around the budget.</li>
+     * </ul>
+     * <p>Quiet scenes run at the maximum scale, a storm of explosions is thinned out while it lasts and recovers after.
+     * #GetScale and #GetReason tell what the governor is doing for debug displays.</p>
+     */
+    class BudgetGovernor
+    {
+    public:
+        enum Reason
+        {
+            reasonOff,                  // no budget set
+            reasonWithinBudget,
+            reasonOverTime,
+            reasonOverPixels,
+            reasonRecovering,
+            reasonAtMinimum             // over the budget but the scale can't go lower
+        };
+
+        BudgetGovernor();
+
+        /**
+         * Set the time ParticleManager::Update and ParticleManager::DrawParticles may take together per update, in milliseconds
+         * 0 (the default) doesn't limit the time.
+         */
+        void SetTargetTime(float milliseconds);
+        float GetTargetTime() const;
+
+        /**
+         * Set the pixels the sprites may cover per update, an estimate of the fill rate
+         * 0 (the default) doesn't limit the pixels.
+         */
+        void SetPixelBudget(float pixels);
+        float GetPixelBudget() const;
+
+        /**
+         * Set the range of the scale, 0.1 to 1 by default
+         */
+        void SetScaleLimits(float minimum, float maximum = 1.0f);
+        float GetMinimumScale() const;
+        float GetMaximumScale() const;
+
+        /**
+         * Set how far from the budget the cost may be before the scale changes, 0.1 (10%) by default
+         */
+        void SetHysteresis(float fraction);
+        float GetHysteresis() const;
+
+        /**
+         * Set how fast the scale may change per update, 0.02 down and 0.005 up by default
+         * At 60 updates a second the scale can halve in about half a second and double in about two seconds.
+         */
+        void SetResponse(float decrease, float increase);
+        float GetDecrease() const;
+        float GetIncrease() const;
+
+        /**
+         * Check if a target time or a pixel budget is set
+         */
+        bool IsEnabled() const;
+
+        /**
+         * Pass in the cost of the last update and get the new scale
+         */
+        float Adjust(float milliseconds, float pixels);
+
+        /**
+         * Go back to the maximum scale and forget the measured cost
+         */
+        void Reset();
+
+        float GetScale() const;
+        Reason GetReason() const;
+        static const char* GetReasonName(Reason reason);
+
+        /**
+         * Get the smoothed cost the scale is adjusted to
+         */
+        float GetTime() const;
+        float GetPixels() const;
+
+    protected:
+        float                   _targetTime;
+        float                   _pixelBudget;
+        float                   _minimumScale;
+        float                   _maximumScale;
+        float                   _hysteresis;
+        float                   _decrease;
+        float                   _increase;
+
+        float                   _scale;
+        Reason                  _reason;
+        float                   _time;
+        float                   _pixels;
+        int                     _samples;
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_BUDGETGOVERNOR_H
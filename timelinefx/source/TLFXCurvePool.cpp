@@ -0,0 +1,131 @@
+#include "TLFXCurvePool.h"
+#include "TLFXEmitterArray.h"
+
+#include <cstdio>
+
+namespace TLFX
+{
+
+    CurvePool::CurvePool()
+        : _curveCount(0)
+        , _sharedCount(0)
+        , _bytesSaved(0)
+        , _compiledBytes(0)
+    {
+
+    }
+
+    CurvePool::~CurvePool()
+    {
+        Clear();
+    }
+
+    EmitterArray* CurvePool::Share( EmitterArray* array )
+    {
+        if (!array)
+            return NULL;
+
+        auto& bucket = _curves[array->GetHash()];
+        for (auto it = bucket.begin(); it != bucket.end(); ++it)
+        {
+            if (*it == array)
+                return array;                       // pooled already, e.g. an emitter visited twice
+        }
+
+        ++_curveCount;
+        for (auto it = bucket.begin(); it != bucket.end(); ++it)
+        {
+            if ((*it)->IsSameCurve(*array))
+            {
+                _bytesSaved += array->GetMemoryBytes();
+                delete array;
+                return *it;
+            }
+        }
+
+        ++_sharedCount;
+        _compiledBytes += array->GetCompiledBytes();
+        array->SetPooled(true);
+        bucket.push_back(array);
+        return array;
+    }
+
+    EmitterArray* CurvePool::Unshare( const EmitterArray* array )
+    {
+        EmitterArray* copy = new EmitterArray(*array);
+        copy->SetPooled(false);
+        return copy;
+    }
+
+    void CurvePool::Clear()
+    {
+        for (auto it = _curves.begin(); it != _curves.end(); ++it)
+        {
+            for (auto it2 = it->second.begin(); it2 != it->second.end(); ++it2)
+                delete *it2;
+        }
+        _curves.clear();
+
+        _curveCount = 0;
+        _sharedCount = 0;
+        _bytesSaved = 0;
+        _compiledBytes = 0;
+    }
+
+    void CurvePool::ReleaseNodes()
+    {
+        for (auto it = _curves.begin(); it != _curves.end(); ++it)
+        {
+            for (auto it2 = it->second.begin(); it2 != it->second.end(); ++it2)
+            {
+                if ((*it2)->IsCompiled())
+                    (*it2)->ReleaseNodes();
+            }
+        }
+    }
+
+    size_t CurvePool::GetMemoryBytes() const
+    {
+        size_t bytes = 0;
+        for (auto it = _curves.begin(); it != _curves.end(); ++it)
+        {
+            for (auto it2 = it->second.begin(); it2 != it->second.end(); ++it2)
+                bytes += (*it2)->GetMemoryBytes();
+        }
+        return bytes;
+    }
+
+    int CurvePool::GetCurveCount() const
+    {
+        return _curveCount;
+    }
+
+    int CurvePool::GetSharedCount() const
+    {
+        return _sharedCount;
+    }
+
+    int CurvePool::GetMergedCount() const
+    {
+        return _curveCount - _sharedCount;
+    }
+
+    size_t CurvePool::GetBytesSaved() const
+    {
+        return _bytesSaved;
+    }
+
+    size_t CurvePool::GetCompiledBytes() const
+    {
+        return _compiledBytes;
+    }
+
+    std::string CurvePool::GetReport() const
+    {
+        char report[256];
+        sprintf(report, "%d curves, %d shared, %d merged, %lu bytes saved, %lu bytes of compiled tables",
+            _curveCount, _sharedCount, GetMergedCount(), (unsigned long)_bytesSaved, (unsigned long)_compiledBytes);
+        return report;
+    }
+
+} // namespace TLFX
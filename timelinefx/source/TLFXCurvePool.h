@@ -0,0 +1,85 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_CURVEPOOL_H
+#define _TLFX_CURVEPOOL_H
+
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <cstddef>
+
+namespace TLFX
+{
+
+    class EmitterArray;
+
+    /**
+     * Curve Pool type
+     * <p>Owns one copy of every distinct compiled curve of an #EffectsLibrary. Curves with the same attribute nodes, value range and compile
+     * parameters compile to the same table, so effects and emitters share a single #EmitterArray for them instead of owning a copy each.
+     * Default curves such as a scale of 1 forever, alpha fades and white color ramps are repeated across most emitters of a library.</p>
+     * <p>Shared curves must not be changed any more, see EmitterArray::SetPooled. Effects and emitters compiled again after sharing
+     * their curves compile copies made with #Unshare instead, see EffectsLibrary::ShareCurves.</p>
+     */
+    class CurvePool
+    {
+    public:
+        CurvePool();
+        ~CurvePool();
+
+        /**
+         * Get the pooled curve equal to array, taking ownership of array
+         * If an equal curve is pooled already array is deleted and the pooled one returned, otherwise array is added to the pool.
+         */
+        EmitterArray* Share(EmitterArray* array);
+
+        /**
+         * Get a copy of a pooled curve that can be compiled and edited, owned by the caller
+         */
+        static EmitterArray* Unshare(const EmitterArray* array);
+
+        /**
+         * Delete all pooled curves and reset the counters
+         */
+        void Clear();
+
+        /**
+         * Free the attribute nodes of all compiled curves in the pool, see EmitterArray::ReleaseNodes
+         */
+        void ReleaseNodes();
+
+        /**
+         * Get the memory taken by the pooled curves, see EmitterArray::GetMemoryBytes
+         */
+        size_t GetMemoryBytes() const;
+
+        /**
+         * Get the number of curves passed to #Share, the number of distinct curves kept and the memory the merged ones took
+         */
+        int GetCurveCount() const;
+        int GetSharedCount() const;
+        int GetMergedCount() const;
+        size_t GetBytesSaved() const;
+        size_t GetCompiledBytes() const;
+
+        /**
+         * Get a one line summary of the counters, for logging
+         */
+        std::string GetReport() const;
+
+    protected:
+        std::unordered_map<size_t, std::vector<EmitterArray*> > _curves;   // by EmitterArray::GetHash
+        int                                                     _curveCount;
+        int                                                     _sharedCount;
+        size_t                                                  _bytesSaved;
+        size_t                                                  _compiledBytes;
+
+        CurvePool(const CurvePool&);
+        CurvePool& operator=(const CurvePool&);
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_CURVEPOOL_H
@@ -0,0 +1,135 @@
+#include "TLFXDepthSorter.h"
+#include "TLFXParticle.h"
+
+#include <cstring>
+
+namespace TLFX
+{
+
+    DepthSorter::DepthSorter()
+        : _insertionSorts(0)
+        , _radixSorts(0)
+    {
+
+    }
+
+    void DepthSorter::Sort( ParticleList& particles )
+    {
+        if (particles.size() < 2)
+            return;
+
+        // most updates nothing moved past a neighbour
+        bool sorted = true;
+        float z = particles.front()->GetZ();
+        for (auto it = ++particles.begin(); it != particles.end() && sorted; ++it)
+        {
+            float next = (*it)->GetZ();
+            sorted = !(next < z);
+            z = next;
+        }
+        if (sorted)
+            return;
+
+        if (InsertionSort(particles, (int)particles.size()))
+        {
+            ++_insertionSorts;
+        }
+        else
+        {
+            RadixSort(particles);
+            ++_radixSorts;
+        }
+    }
+
+    int DepthSorter::GetInsertionSorts() const
+    {
+        return _insertionSorts;
+    }
+
+    int DepthSorter::GetRadixSorts() const
+    {
+        return _radixSorts;
+    }
+
+    bool DepthSorter::InsertionSort( ParticleList& particles, int budget )
+    {
+        auto begin = particles.begin();
+        for (auto it = ++particles.begin(); it != particles.end(); )
+        {
+            auto next = it;
+            ++next;
+
+            float z = (*it)->GetZ();
+            auto pos = it;
+            while (pos != begin)
+            {
+                auto before = pos;
+                --before;
+                if (!(z < (*before)->GetZ()))
+                    break;
+                pos = before;
+                if (--budget < 0)
+                    return false;           // too far from sorted, the list is still complete though
+            }
+
+            if (pos != it)
+            {
+                particles.splice(pos, particles, it);
+                if (pos == begin)
+                    begin = it;
+            }
+            it = next;
+        }
+        return true;
+    }
+
+    void DepthSorter::RadixSort( ParticleList& particles )
+    {
+        _keys.resize(particles.size());
+        _sorted.resize(particles.size());
+
+        size_t n = 0;
+        for (auto it = particles.begin(); it != particles.end(); ++it, ++n)
+        {
+            _keys[n].z = SortKey((*it)->GetZ());
+            _keys[n].particle = it;
+        }
+
+        // least significant byte first, every pass keeps the order of the previous one
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            size_t offsets[256];
+            memset(offsets, 0, sizeof(offsets));
+            for (size_t i = 0; i < n; ++i)
+                ++offsets[(_keys[i].z >> shift) & 0xff];
+
+            if (offsets[(_keys[0].z >> shift) & 0xff] == n)
+                continue;                   // all keys share this byte
+
+            size_t total = 0;
+            for (int b = 0; b < 256; ++b)
+            {
+                size_t count = offsets[b];
+                offsets[b] = total;
+                total += count;
+            }
+
+            for (size_t i = 0; i < n; ++i)
+                _sorted[offsets[(_keys[i].z >> shift) & 0xff]++] = _keys[i];
+            _keys.swap(_sorted);
+        }
+
+        // move every particle to the end in order
+        for (size_t i = 0; i < n; ++i)
+            particles.splice(particles.end(), particles, _keys[i].particle);
+    }
+
+    unsigned int DepthSorter::SortKey( float z )
+    {
+        // orders like the floats: negative ones reversed and below the positive ones
+        unsigned int bits;
+        memcpy(&bits, &z, sizeof(bits));
+        return (bits & 0x80000000) ? ~bits : bits | 0x80000000;
+    }
+
+} // namespace TLFX
@@ -0,0 +1,60 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_DEPTHSORTER_H
+#define _TLFX_DEPTHSORTER_H
+
+#include <list>
+#include <vector>
+
+namespace TLFX
+{
+
+    class Particle;
+
+    typedef std::list<Particle*> ParticleList;
+
+    /**
+     * Depth Sorter type
+     * <p>Keeps particle lists sorted by z (Entity::GetZ), lowest first, so particles further away are drawn first. The lists keep their
+     * order from one update to the next and z changes slowly, so a list is mostly sorted already: an insertion pass moves the few particles
+     * that are out of place and new particles from the end to where they belong. When that would take more steps than the list has
+     * particles, after a big change, the list is radix sorted instead. Either way the cost stays close to linear.</p>
+     * <p>Particles are moved by relinking the list, so the iterators particles keep of their place (Particle::GetIter) stay valid.
+     * Particles with the same z keep their order.</p>
+     */
+    class DepthSorter
+    {
+    public:
+        DepthSorter();
+
+        void Sort(ParticleList& particles);
+
+        /**
+         * Get the number of lists that needed the insertion pass and the radix sort, since the sorter was created
+         */
+        int GetInsertionSorts() const;
+        int GetRadixSorts() const;
+
+    protected:
+        struct Key
+        {
+            unsigned int            z;
+            ParticleList::iterator  particle;
+        };
+
+        std::vector<Key>            _keys;              // scratch for the radix sort
+        std::vector<Key>            _sorted;
+        int                         _insertionSorts;
+        int                         _radixSorts;
+
+        bool InsertionSort(ParticleList& particles, int budget);
+        void RadixSort(ParticleList& particles);
+
+        static unsigned int SortKey(float z);
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_DEPTHSORTER_H
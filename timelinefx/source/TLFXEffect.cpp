@@ -3,9 +3,12 @@
 #include "TLFXParticleManager.h"
 #include "TLFXEmitter.h"
 #include "TLFXParticle.h"
+#include "TLFXCurvePool.h"
+#include "TLFXDepthSorter.h"
 
 #include <cassert>
 #include <algorithm>
+#include <cmath>
 
 namespace TLFX
 {
@@ -42,6 +45,7 @@ namespace TLFX
         , _ellipseOffset(0)
         , _effectLayer(0)
         , _doesNotTimeout(false)
+        , _handle(0)
 
         , _particleManager(NULL)
 
@@ -88,6 +92,9 @@ namespace TLFX
         , _bypassWeight(false)
 
         , _arrayOwner(true)
+        , _sharedAttributeCache(NULL)
+        , _budgetWeight(1.0f)
+        , _budgetScale(1.0f)
     {
         _inUse.resize(10);
 
@@ -141,6 +148,7 @@ namespace TLFX
         , _ellipseOffset(o._ellipseOffset)
         , _effectLayer(o._effectLayer)
         , _doesNotTimeout(o._doesNotTimeout)
+        , _handle(0)
 
         , _particleManager(pm)
 
@@ -204,6 +212,9 @@ namespace TLFX
         , _cEffectAngle(o._cEffectAngle)
         , _cStretch(o._cStretch)
         , _cGlobalZ(o._cGlobalZ)
+        , _sharedAttributeCache(o._sharedAttributeCache)    // the library effect keeps the cache
+        , _budgetWeight(o._budgetWeight)
+        , _budgetScale(1.0f)
 
         // copy automatically: base/entity
         // not copy: Directories, inUse
@@ -211,6 +222,7 @@ namespace TLFX
         _inUse.resize(10);
 
         SetEllipseArc(o._ellipseArc);
+        SetTimeContext(&pm->GetTimeContext());
         _dob = pm->GetCurrentTime();
         SetOKtoRender(false);
 
@@ -312,6 +324,8 @@ namespace TLFX
     void Effect::SetParticleManager( ParticleManager *particleManager )
     {
         _particleManager = particleManager;
+        if (particleManager)
+            SetTimeContext(&particleManager->GetTimeContext());
     }
 
     /*
@@ -609,6 +623,21 @@ namespace TLFX
         _currentAmount = amount;
     }
 
+    void Effect::SetBudgetWeight( float weight )
+    {
+        _budgetWeight = weight;
+    }
+
+    float Effect::GetBudgetWeight() const
+    {
+        return _budgetWeight;
+    }
+
+    float Effect::GetBudgetScale() const
+    {
+        return _budgetScale;
+    }
+
     void Effect::SetVelocity( float velocity )
     {
         _overrideVelocity = true;
@@ -926,7 +955,13 @@ namespace TLFX
             _age = 0;
         }
 
-        _currentEffectFrame = _age / EffectsLibrary::GetLookupFrequency();
+        _currentEffectFrame = _age * EffectsLibrary::GetInvLookupFrequency();
+
+        float budgetScale = _particleManager->GetBudgetScale();
+        _budgetScale = _budgetWeight == 1.0f ? budgetScale : powf(budgetScale, _budgetWeight);
+
+        float attributes[attributeCount];
+        GetAttributes(_currentEffectFrame, attributes);
 
         if (!_overrideSize)
         {
@@ -938,11 +973,11 @@ namespace TLFX
                 break;
             case TypeArea:
             case TypeEllipse:
-                _currentWidth = GetWidth(_currentEffectFrame);
-                _currentHeight = GetHeight(_currentEffectFrame);
+                _currentWidth = attributes[attrWidth];
+                _currentHeight = attributes[attrHeight];
                 break;
             case TypeLine:
-                _currentWidth = GetWidth(_currentEffectFrame);
+                _currentWidth = attributes[attrWidth];
                 _currentHeight = 0;
                 break;
             }
@@ -966,51 +1001,51 @@ namespace TLFX
 
         if (_parentEmitter)
         {
-            if (!_overrideLife)          _currentLife          = GetLife(_currentEffectFrame)     * _parentEmitter->GetParentEffect()->_currentLife;
-            if (!_overrideAmount)        _currentAmount        = GetAmount(_currentEffectFrame)   * _parentEmitter->GetParentEffect()->_currentAmount;
+            if (!_overrideLife)          _currentLife          = attributes[attrLife]     * _parentEmitter->GetParentEffect()->_currentLife;
+            if (!_overrideAmount)        _currentAmount        = attributes[attrAmount]   * _parentEmitter->GetParentEffect()->_currentAmount;
             if (_lockAspect)
             {
-                if (!_overrideSizeX)     _currentSizeX         = GetSizeX(_currentEffectFrame)    * _parentEmitter->GetParentEffect()->_currentSizeX;
+                if (!_overrideSizeX)     _currentSizeX         = attributes[attrSizeX]    * _parentEmitter->GetParentEffect()->_currentSizeX;
                 if (!_overrideSizeY)     _currentSizeY         = _currentSizeX                    * _parentEmitter->GetParentEffect()->_currentSizeY;
             }
             else
             {
-                if (!_overrideSizeX)     _currentSizeX         = GetSizeX(_currentEffectFrame)    * _parentEmitter->GetParentEffect()->_currentSizeX;
-                if (!_overrideSizeY)     _currentSizeY         = GetSizeY(_currentEffectFrame)    * _parentEmitter->GetParentEffect()->_currentSizeY;
+                if (!_overrideSizeX)     _currentSizeX         = attributes[attrSizeX]    * _parentEmitter->GetParentEffect()->_currentSizeX;
+                if (!_overrideSizeY)     _currentSizeY         = attributes[attrSizeY]    * _parentEmitter->GetParentEffect()->_currentSizeY;
             }
-            if (!_overrideVelocity)      _currentVelocity      = GetVelocity(_currentEffectFrame) * _parentEmitter->GetParentEffect()->_currentVelocity;
-            if (!_overrideWeight)        _currentWeight        = GetWeight(_currentEffectFrame)   * _parentEmitter->GetParentEffect()->_currentWeight;
-            if (!_overrideSpin)          _currentSpin          = GetSpin(_currentEffectFrame)     * _parentEmitter->GetParentEffect()->_currentSpin;
-            if (!_overrideAlpha)         _currentAlpha         = GetAlpha(_currentEffectFrame)    * _parentEmitter->GetParentEffect()->_currentAlpha;
-            if (!_overrideEmissionAngle) _currentEmissionAngle = GetEmissionAngle(_currentEffectFrame);
-            if (!_overrideEmissionRange) _currentEmissionRange = GetEmissionRange(_currentEffectFrame);
-            if (!_overrideAngle)         _angle                = GetEffectAngle(_currentEffectFrame);
-            if (!_overrideStretch)       _currentStretch       = GetStretch(_currentEffectFrame)  *  _parentEmitter->GetParentEffect()->_currentStretch;
-            if (!_overrideGlobalZ)       _currentGlobalZ       = GetGlobalZ(_currentEffectFrame)  *  _parentEmitter->GetParentEffect()->_currentGlobalZ;
+            if (!_overrideVelocity)      _currentVelocity      = attributes[attrVelocity] * _parentEmitter->GetParentEffect()->_currentVelocity;
+            if (!_overrideWeight)        _currentWeight        = attributes[attrWeight]   * _parentEmitter->GetParentEffect()->_currentWeight;
+            if (!_overrideSpin)          _currentSpin          = attributes[attrSpin]     * _parentEmitter->GetParentEffect()->_currentSpin;
+            if (!_overrideAlpha)         _currentAlpha         = attributes[attrAlpha]    * _parentEmitter->GetParentEffect()->_currentAlpha;
+            if (!_overrideEmissionAngle) _currentEmissionAngle = attributes[attrEmissionAngle];
+            if (!_overrideEmissionRange) _currentEmissionRange = attributes[attrEmissionRange];
+            if (!_overrideAngle)         _angle                = attributes[attrEffectAngle];
+            if (!_overrideStretch)       _currentStretch       = attributes[attrStretch]  *  _parentEmitter->GetParentEffect()->_currentStretch;
+            if (!_overrideGlobalZ)       _currentGlobalZ       = attributes[attrGlobalZ]  *  _parentEmitter->GetParentEffect()->_currentGlobalZ;
         }
         else
         {
-            if (!_overrideLife)          _currentLife          = GetLife(_currentEffectFrame);
-            if (!_overrideAmount)        _currentAmount        = GetAmount(_currentEffectFrame);
+            if (!_overrideLife)          _currentLife          = attributes[attrLife];
+            if (!_overrideAmount)        _currentAmount        = attributes[attrAmount];
             if (_lockAspect)
             {
-                if (!_overrideSizeX)     _currentSizeX         = GetSizeX(_currentEffectFrame);
+                if (!_overrideSizeX)     _currentSizeX         = attributes[attrSizeX];
                 if (!_overrideSizeY)     _currentSizeY         = _currentSizeX;
             }
             else
             {
-                if (!_overrideSizeX)     _currentSizeX         = GetSizeX(_currentEffectFrame);
-                if (!_overrideSizeY)     _currentSizeY         = GetSizeY(_currentEffectFrame);
+                if (!_overrideSizeX)     _currentSizeX         = attributes[attrSizeX];
+                if (!_overrideSizeY)     _currentSizeY         = attributes[attrSizeY];
             }
-            if (!_overrideVelocity)      _currentVelocity      = GetVelocity(_currentEffectFrame);
-            if (!_overrideWeight)        _currentWeight        = GetWeight(_currentEffectFrame);
-            if (!_overrideSpin)          _currentSpin          = GetSpin(_currentEffectFrame);
-            if (!_overrideAlpha)         _currentAlpha         = GetAlpha(_currentEffectFrame);
-            if (!_overrideEmissionAngle) _currentEmissionAngle = GetEmissionAngle(_currentEffectFrame);
-            if (!_overrideEmissionRange) _currentEmissionRange = GetEmissionRange(_currentEffectFrame);
-            if (!_overrideAngle)         _angle                = GetEffectAngle(_currentEffectFrame);
-            if (!_overrideStretch)       _currentStretch       = GetStretch(_currentEffectFrame);
-            if (!_overrideGlobalZ)       _currentGlobalZ       = GetGlobalZ(_currentEffectFrame);
+            if (!_overrideVelocity)      _currentVelocity      = attributes[attrVelocity];
+            if (!_overrideWeight)        _currentWeight        = attributes[attrWeight];
+            if (!_overrideSpin)          _currentSpin          = attributes[attrSpin];
+            if (!_overrideAlpha)         _currentAlpha         = attributes[attrAlpha];
+            if (!_overrideEmissionAngle) _currentEmissionAngle = attributes[attrEmissionAngle];
+            if (!_overrideEmissionRange) _currentEmissionRange = attributes[attrEmissionRange];
+            if (!_overrideAngle)         _angle                = attributes[attrEffectAngle];
+            if (!_overrideStretch)       _currentStretch       = attributes[attrStretch];
+            if (!_overrideGlobalZ)       _currentGlobalZ       = attributes[attrGlobalZ];
         }
 
         if (!_overrideGlobalZ)
@@ -1062,20 +1097,14 @@ namespace TLFX
         _directoryEmitters.clear();
         for (int i = 0; i < 10; ++i)
         {
-            while (!_inUse[i].empty())
-            {
-                Particle *p = *_inUse[i].begin();
-                p->Reset();
-                _particleManager->ReleaseParticle(p);
-                RemoveInUse(i, p);
-            }
-            _inUse[i].clear();              // should be already clear (RemoveInUse erases the items)
+            _inUse[i].clear();              // the particles are children of the emitters, which release them below
         }
         base::Destroy(releaseChildren);
     }
 
     void Effect::CompileAll()
     {
+        UnshareArrays();
         CompileLife();
         CompileAmount();
         CompileSizeX();
@@ -1098,6 +1127,18 @@ namespace TLFX
             Emitter* e = static_cast<Emitter*>(*it);
             e->CompileAll();
         }
+
+        if (EffectsLibrary::GetCompileQuantized())
+        {
+            EmitterArray* fixed[] = { _cLife, _cAmount, _cSizeX, _cSizeY, _cVelocity, _cWeight, _cSpin, _cAlpha, _cEmissionAngle, _cEmissionRange,
+                _cWidth, _cHeight, _cEffectAngle, _cStretch, _cGlobalZ };
+            for (size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); ++i)
+                fixed[i]->SetStorage(EmitterArray::StorageShort);
+        }
+
+        // cached values are out of date
+        _attributeCache.Reset(attributeCount, EffectsLibrary::GetAttributeCacheSize());
+        _sharedAttributeCache = _attributeCache.IsEnabled() ? &_attributeCache : NULL;
     }
 
     void Effect::CompileQuick()
@@ -1111,78 +1152,187 @@ namespace TLFX
         }
     }
 
+    void Effect::ShareArrays( CurvePool& pool )
+    {
+        if (_arrayOwner)
+        {
+            _cLife = pool.Share(_cLife);
+            _cAmount = pool.Share(_cAmount);
+            _cSizeX = pool.Share(_cSizeX);
+            _cSizeY = pool.Share(_cSizeY);
+            _cVelocity = pool.Share(_cVelocity);
+            _cWeight = pool.Share(_cWeight);
+            _cSpin = pool.Share(_cSpin);
+            _cAlpha = pool.Share(_cAlpha);
+            _cEmissionAngle = pool.Share(_cEmissionAngle);
+            _cEmissionRange = pool.Share(_cEmissionRange);
+            _cWidth = pool.Share(_cWidth);
+            _cHeight = pool.Share(_cHeight);
+            _cEffectAngle = pool.Share(_cEffectAngle);
+            _cStretch = pool.Share(_cStretch);
+            _cGlobalZ = pool.Share(_cGlobalZ);
+            _arrayOwner = false;            // the pool owns them now
+        }
+
+        // Emitter
+        for (auto it = _children.begin(); it != _children.end(); ++it)
+        {
+            Emitter* e = static_cast<Emitter*>(*it);
+            e->ShareArrays(pool);
+        }
+    }
+
+    void Effect::UnshareArrays()
+    {
+        // the pool keeps its arrays for the other effects sharing them
+        if (_arrayOwner || !_cLife->IsPooled())
+            return;
+
+        _cLife = CurvePool::Unshare(_cLife);
+        _cAmount = CurvePool::Unshare(_cAmount);
+        _cSizeX = CurvePool::Unshare(_cSizeX);
+        _cSizeY = CurvePool::Unshare(_cSizeY);
+        _cVelocity = CurvePool::Unshare(_cVelocity);
+        _cWeight = CurvePool::Unshare(_cWeight);
+        _cSpin = CurvePool::Unshare(_cSpin);
+        _cAlpha = CurvePool::Unshare(_cAlpha);
+        _cEmissionAngle = CurvePool::Unshare(_cEmissionAngle);
+        _cEmissionRange = CurvePool::Unshare(_cEmissionRange);
+        _cWidth = CurvePool::Unshare(_cWidth);
+        _cHeight = CurvePool::Unshare(_cHeight);
+        _cEffectAngle = CurvePool::Unshare(_cEffectAngle);
+        _cStretch = CurvePool::Unshare(_cStretch);
+        _cGlobalZ = CurvePool::Unshare(_cGlobalZ);
+        _arrayOwner = true;
+    }
+
+    void Effect::GetAttributes( float frame, float* values ) const
+    {
+        if (_sharedAttributeCache && _sharedAttributeCache->Get(frame, values))
+            return;
+
+        values[attrLife]          = GetLife(frame);
+        values[attrAmount]        = GetAmount(frame);
+        values[attrSizeX]         = GetSizeX(frame);
+        values[attrSizeY]         = GetSizeY(frame);
+        values[attrVelocity]      = GetVelocity(frame);
+        values[attrWeight]        = GetWeight(frame);
+        values[attrSpin]          = GetSpin(frame);
+        values[attrAlpha]         = GetAlpha(frame);
+        values[attrEmissionAngle] = GetEmissionAngle(frame);
+        values[attrEmissionRange] = GetEmissionRange(frame);
+        values[attrWidth]         = GetWidth(frame);
+        values[attrHeight]        = GetHeight(frame);
+        values[attrEffectAngle]   = GetEffectAngle(frame);
+        values[attrStretch]       = GetStretch(frame);
+        values[attrGlobalZ]       = GetGlobalZ(frame);
+
+        if (_sharedAttributeCache)
+            _sharedAttributeCache->Set(frame, values);
+    }
+
+    int Effect::ReleaseDirectory()
+    {
+        int released = (int)(_directoryEffects.size() + _directoryEmitters.size());
+        std::map<std::string, Effect*>().swap(_directoryEffects);
+        std::map<std::string, Emitter*>().swap(_directoryEmitters);
+
+        for (auto it = _children.begin(); it != _children.end(); ++it)
+        {
+            const std::list<Effect*>& effects = static_cast<Emitter*>(*it)->GetEffects();
+            for (auto it2 = effects.begin(); it2 != effects.end(); ++it2)
+                released += (*it2)->ReleaseDirectory();
+        }
+        return released;
+    }
+
     void Effect::CompileAmount()
     {
+        UnshareArrays();
         _cAmount->Compile();
     }
 
     void Effect::CompileLife()
     {
+        UnshareArrays();
         _cLife->Compile();
     }
 
     void Effect::CompileSizeX()
     {
+        UnshareArrays();
         _cSizeX->Compile();
     }
 
     void Effect::CompileSizeY()
     {
+        UnshareArrays();
         _cSizeY->Compile();
     }
 
     void Effect::CompileVelocity()
     {
+        UnshareArrays();
         _cVelocity->Compile();
     }
 
     void Effect::CompileWeight()
     {
+        UnshareArrays();
         _cWeight->Compile();
     }
 
     void Effect::CompileSpin()
     {
+        UnshareArrays();
         _cSpin->Compile();
     }
 
     void Effect::CompileAlpha()
     {
+        UnshareArrays();
         _cAlpha->Compile();
     }
 
     void Effect::CompileEmissionAngle()
     {
+        UnshareArrays();
         _cEmissionAngle->Compile();
     }
 
     void Effect::CompileEmissionRange()
     {
+        UnshareArrays();
         _cEmissionRange->Compile();
     }
 
     void Effect::CompileWidth()
     {
+        UnshareArrays();
         _cWidth->Compile();
     }
 
     void Effect::CompileHeight()
     {
+        UnshareArrays();
         _cHeight->Compile();
     }
 
     void Effect::CompileAngle()
     {
+        UnshareArrays();
         _cEffectAngle->Compile();
     }
 
     void Effect::CompileStretch()
     {
+        UnshareArrays();
         _cStretch->Compile();
     }
 
     void Effect::CompileGlobalZ()
     {
+        UnshareArrays();
         _cGlobalZ->Compile();
         _cGlobalZ->SetCompiled(0, 1.0f);
     }
@@ -1305,11 +1455,36 @@ namespace TLFX
         return _inUse[layer];
     }
 
+    void Effect::SortParticles( DepthSorter& sorter )
+    {
+        for (size_t i = 0; i < _inUse.size(); ++i)
+        {
+            sorter.Sort(_inUse[i]);
+
+            for (auto it = _inUse[i].begin(); it != _inUse[i].end(); ++it)
+            {
+                auto& subeffects = (*it)->GetChildren();
+                for (auto it2 = subeffects.begin(); it2 != subeffects.end(); ++it2)
+                    static_cast<Effect*>(*it2)->SortParticles(sorter);
+            }
+        }
+    }
+
     bool Effect::IsDying() const
     {
         return _dying;
     }
 
+    void Effect::SetHandle( unsigned int handle )
+    {
+        _handle = handle;
+    }
+
+    unsigned int Effect::GetHandle() const
+    {
+        return _handle;
+    }
+
     ParticleManager* Effect::GetParticleManager() const
     {
         return _particleManager;
@@ -60,6 +60,7 @@
 #define _TLFX_EFFECT_H
 
 #include "TLFXEntity.h"
+#include "TLFXAttributeCache.h"
 #include "TLFXAttributeNode.h"
 #include "TLFXEmitterArray.h"
 
@@ -72,7 +73,9 @@ namespace TLFX
 {
     class Emitter;
     class Particle;
+    class DepthSorter;
     class ParticleManager;
+    class CurvePool;
     class Shape;
 	
 	typedef std::list<Particle*> ParticleList;
@@ -498,6 +501,19 @@ namespace TLFX
          */
         void SetAmount(float amount);
 
+        /**
+         * Set how strongly the budget governor of the particle manager thins out this effect, see ParticleManager::GetBudgetGovernor
+         * The amount is scaled by the budget scale to the power of weight: 1 (the default) follows the governor, 0 keeps the effect
+         * at full amount whatever the budget, 2 thins it out faster than the rest, for effects that matter least.
+         */
+        void SetBudgetWeight(float weight);
+        float GetBudgetWeight() const;
+
+        /**
+         * Get the scale of the amount from the budget governor in the current update, see #SetBudgetWeight
+         */
+        float GetBudgetScale() const;
+
         /**
          * Set the Global attribute velocity of the effect
          * This overrides the graph the effect uses to set the Global Attribute _velocity
@@ -789,6 +805,20 @@ namespace TLFX
         void CompileAll();
         void CompileQuick();
 
+        /**
+         * Hand the attribute arrays to the pool so identical curves are shared, see EffectsLibrary::ShareCurves
+         * The pool takes ownership of the arrays, they must not be changed afterwards. Compiling the effect again first gives it its
+         * own copy of every pooled array, the other effects sharing them keep the pooled ones.
+         */
+        void ShareArrays(CurvePool& pool);
+
+        /**
+         * Free the directories of sub effects and emitters, see EffectsLibrary::SetRuntimeOnly
+         * #GetEffect and #GetEmitter find nothing afterwards.
+         * @return the number of directory entries freed, including the ones of sub effects
+         */
+        int ReleaseDirectory();
+
         void CompileAmount();
         void CompileLife();
         void CompileSizeX();
@@ -860,8 +890,20 @@ namespace TLFX
 
         const ParticleList& GetParticles(int layer) const;
 
+        /**
+         * Sort the particles managed by this effect and its sub effects by z, see ParticleManager::SetDepthSorted
+         */
+        void SortParticles(DepthSorter& sorter);
+
         bool IsDying() const;
 
+        /**
+         * Set the handle the particle manager knows this effect by, see ParticleManager::QueueSpawnEffect
+         * 0 when the effect wasn't spawned through the command queue.
+         */
+        void SetHandle(unsigned int handle);
+        unsigned int GetHandle() const;
+
     protected:
         std::map<std::string, Effect*> _directoryEffects;       /// The directory of all the effect's sub effects and emitters.
         std::map<std::string, Emitter*> _directoryEmitters;     /// The directory of all the effect's emitters.
@@ -897,6 +939,7 @@ namespace TLFX
         std::vector<ParticleList>      _inUse;                  /// This stores particles created by the effect, for drawing purposes only.
         int                            _effectLayer;            /// The layer that the effect resides on in its particle manager
         bool                           _doesNotTimeout;         /// Whether the effect never timeouts automatically
+        unsigned int                   _handle;                 /// Handle of the effect in its particle manager's command queue
 
         ParticleManager*               _particleManager;        /// The particle manager that this effect belongs to
 
@@ -928,6 +971,18 @@ namespace TLFX
         EmitterArray*                  _cStretch;
         EmitterArray*                  _cGlobalZ;
         bool                           _arrayOwner;             // only the effects/emitters in EffectsLibrary should be the owners, not the copies
+        void UnshareArrays();                                   // copy pooled arrays before compiling them, see ShareArrays
+
+        /// attributes looked up by Update, in the order of the cache, see GetAttributes
+        enum Attribute
+        {
+            attrLife, attrAmount, attrSizeX, attrSizeY, attrVelocity, attrWeight, attrSpin, attrAlpha,
+            attrEmissionAngle, attrEmissionRange, attrWidth, attrHeight, attrEffectAngle, attrStretch, attrGlobalZ,
+            attributeCount
+        };
+        AttributeCache                 _attributeCache;         // attributes at recent frames for all copies of this library effect
+        AttributeCache*                _sharedAttributeCache;   // _attributeCache of the library effect, NULL when not compiled
+        void GetAttributes(float frame, float* values) const;
 
         float                          _currentLife;
         float                          _currentAmount;
@@ -960,6 +1015,9 @@ namespace TLFX
         bool                           _overrideGlobalZ;
 
         bool                           _bypassWeight;
+
+        float                          _budgetWeight;
+        float                          _budgetScale;            // budget scale of the particle manager to the power of _budgetWeight
     };
 
 } // namespace TLFX
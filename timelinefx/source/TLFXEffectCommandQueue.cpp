@@ -0,0 +1,75 @@
+#include "TLFXEffectCommandQueue.h"
+
+#include <cassert>
+
+namespace TLFX
+{
+
+    EffectCommandQueue::EffectCommandQueue( int capacity )
+        : _cells()
+        , _mask(0)
+        , _enqueuePos(0)
+        , _dequeuePos(0)
+    {
+        assert(capacity > 0);
+
+        size_t size = 2;
+        while (size < (size_t)capacity)
+            size <<= 1;
+
+        std::vector<Cell> cells(size);
+        _cells.swap(cells);
+        _mask = size - 1;
+
+        for (size_t i = 0; i < size; ++i)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool EffectCommandQueue::Push( const EffectCommand& command )
+    {
+        size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = _cells[pos & _mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+            if (diff == 0)
+            {
+                // slot is free for this position, claim it
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.command = command;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;               // full, the consumer hasn't freed this slot yet
+            }
+            else
+            {
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool EffectCommandQueue::Pop( EffectCommand& command )
+    {
+        Cell& cell = _cells[_dequeuePos & _mask];
+        size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (seq != _dequeuePos + 1)
+            return false;
+
+        command = cell.command;
+        cell.sequence.store(_dequeuePos + _mask + 1, std::memory_order_release);
+        ++_dequeuePos;
+        return true;
+    }
+
+    int EffectCommandQueue::GetCapacity() const
+    {
+        return (int)_cells.size();
+    }
+
+} // namespace TLFX
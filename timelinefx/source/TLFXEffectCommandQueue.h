@@ -0,0 +1,86 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_EFFECTCOMMANDQUEUE_H
+#define _TLFX_EFFECTCOMMANDQUEUE_H
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+namespace TLFX
+{
+
+    class Effect;
+
+    /**
+     * Effect Command type
+     * <p>A request from another thread to spawn, kill or move an effect of a #ParticleManager. Effects are referred to by the handle
+     * returned by ParticleManager::QueueSpawnEffect, as the effect itself is only created when the queue is drained.</p>
+     */
+    struct EffectCommand
+    {
+        enum Type
+        {
+            spawn,
+            softKill,
+            hardKill,
+            move
+        };
+
+        Type            type;
+        unsigned int    handle;
+        const Effect*   effect;         // template to copy, spawn only
+        float           x, y;
+        int             layer;
+    };
+
+    /**
+     * Effect Command Queue type
+     * <p>Bounded lock free queue for any number of producer threads and one consumer, the thread updating the particle manager.
+     * All storage is allocated up front, so #Push never allocates and never blocks: it fails when the queue is full.</p>
+     * <p>Every slot carries a sequence number telling whether it is free for the producer of a given position or holds a command
+     * for the consumer, producers claim positions with a compare and swap on the enqueue counter.</p>
+     */
+    class EffectCommandQueue
+    {
+    public:
+        /**
+         * Create the queue, capacity is rounded up to a power of 2
+         */
+        EffectCommandQueue(int capacity);
+
+        /**
+         * Add a command, safe to call from any thread
+         * @return false if the queue is full
+         */
+        bool Push(const EffectCommand& command);
+
+        /**
+         * Take the oldest command, only call from the consumer thread
+         * @return false if the queue is empty
+         */
+        bool Pop(EffectCommand& command);
+
+        int GetCapacity() const;
+
+    protected:
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            EffectCommand       command;
+        };
+
+        std::vector<Cell>   _cells;
+        size_t              _mask;
+        std::atomic<size_t> _enqueuePos;
+        size_t              _dequeuePos;        // consumer only
+
+        EffectCommandQueue(const EffectCommandQueue&);
+        EffectCommandQueue& operator=(const EffectCommandQueue&);
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_EFFECTCOMMANDQUEUE_H
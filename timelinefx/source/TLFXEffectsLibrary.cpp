@@ -3,7 +3,11 @@
 #include "TLFXEmitter.h"
 #include "TLFXAnimImage.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
 
 namespace TLFX
 {
@@ -81,14 +85,15 @@ int EffectsLibrary::particlesCreated = 0;
 #endif
 
 
-float EffectsLibrary::_updateFrequency           = 30.0f;                  //  times per second
-float EffectsLibrary::_updateTime                = 1000.0f / EffectsLibrary::_updateFrequency;
-float EffectsLibrary::_currentUpdateTime         = EffectsLibrary::_updateFrequency;
-float EffectsLibrary::_lookupFrequency           = EffectsLibrary::_updateTime;
-float EffectsLibrary::_lookupFrequencyOverTime   = 1.0f;
+TimeContext EffectsLibrary::_defaultTimeContext;                          // 30 times per second
+EffectsLibrary::CompileSettings EffectsLibrary::_compileSettings;
 
 
 EffectsLibrary::EffectsLibrary()
+    : _scheduler(NULL)
+    , _runtimeOnly(false)
+    , _atlasPageSize(0)
+    , _trimThreshold(-1)
 {
 
 }
@@ -111,17 +116,52 @@ bool EffectsLibrary::Load( const char *filename, bool compile /*= true*/ )
         }
         delete shape;               // last even shape is safe to delete
 
+        if (_trimThreshold >= 0 && !TrimShapes(_trimThreshold))
+        {
+            TLFXLOG(EFFECTS, ("shapes left untrimmed"));
+        }
+
+        if (_atlasPageSize > 0 && !BuildAtlas(_atlasPageSize))
+        {
+            TLFXLOG(EFFECTS, ("shapes left out of the atlas"));
+        }
+
+        std::vector<Effect*> effects;
         Effect *effect;
         while ((effect = loader->GetNextEffect(_shapeList)))
         {
-            if (compile)
-                effect->CompileAll();
+            effects.push_back(effect);
+        }
 
-            AddEffect(effect);
+        // every effect compiles its own attributes, so they can be compiled in parallel
+        if (compile)
+        {
+            GetTaskScheduler()->ParallelFor((int)effects.size(), 1, [&effects](int begin, int end)
+            {
+                for (int i = begin; i < end; ++i)
+                    effects[i]->CompileAll();
+            });
+        }
+
+        for (auto it = effects.begin(); it != effects.end(); ++it)
+        {
+            AddEffect(*it);
             // ??? effect->NewDirectory();
             // ??? effect->AddEffect(effect);
         }
 
+        if (compile)
+        {
+            std::string report = ShareCurves();
+            TLFXLOG(EFFECTS, ("shared curves: %s", report.c_str()));
+
+            if (_runtimeOnly)
+            {
+                report = ReleaseAuthoringData();
+                TLFXLOG(EFFECTS, ("released authoring data: %s", report.c_str()));
+            }
+        }
+
         _name = filename;
     }
 
@@ -129,6 +169,157 @@ bool EffectsLibrary::Load( const char *filename, bool compile /*= true*/ )
     return loaded;
 }
 
+std::string EffectsLibrary::ShareCurves()
+{
+    for (auto it = _effects.begin(); it != _effects.end(); ++it)
+        it->second->ShareArrays(_curvePool);
+
+    for (auto it = _emitters.begin(); it != _emitters.end(); ++it)
+        it->second->ShareArrays(_curvePool);
+
+    return _curvePool.GetReport();
+}
+
+const CurvePool& EffectsLibrary::GetCurvePool() const
+{
+    return _curvePool;
+}
+
+void EffectsLibrary::SetRuntimeOnly( bool value )
+{
+    _runtimeOnly = value;
+}
+
+bool EffectsLibrary::IsRuntimeOnly() const
+{
+    return _runtimeOnly;
+}
+
+std::string EffectsLibrary::ReleaseAuthoringData()
+{
+    size_t curvesBefore = _curvePool.GetMemoryBytes();
+    _curvePool.ReleaseNodes();
+    size_t curvesAfter = _curvePool.GetMemoryBytes();
+
+    // a map node per entry, with its key
+    int entries = 0;
+    for (auto it = _effects.begin(); it != _effects.end(); ++it)
+        entries += it->second->ReleaseDirectory();
+    size_t directories = entries * (sizeof(std::pair<const std::string, Effect*>) + 4 * sizeof(void*));
+
+    char report[256];
+    sprintf(report, "curves %lu -> %lu bytes, %d directory entries (about %lu bytes) released",
+        (unsigned long)curvesBefore, (unsigned long)curvesAfter, entries, (unsigned long)directories);
+    return report;
+}
+
+void EffectsLibrary::SetAtlasPageSize( int size )
+{
+    _atlasPageSize = size;
+}
+
+int EffectsLibrary::GetAtlasPageSize() const
+{
+    return _atlasPageSize;
+}
+
+void EffectsLibrary::SetTrimThreshold( int threshold )
+{
+    _trimThreshold = threshold;
+}
+
+int EffectsLibrary::GetTrimThreshold() const
+{
+    return _trimThreshold;
+}
+
+bool EffectsLibrary::TrimShapes( int threshold, int vertices /*= AnimImage::maxHullVertices*/ )
+{
+    bool trimmed = true;
+    for (auto it = _shapeList.begin(); it != _shapeList.end(); ++it)
+    {
+        if (!(*it)->Trim(threshold, vertices))
+        {
+            (*it)->ClearHulls();
+            trimmed = false;
+        }
+    }
+    return trimmed;
+}
+
+bool EffectsLibrary::BuildAtlas( int pageSize /*= TextureAtlas::defaultPageSize*/, int padding /*= TextureAtlas::defaultPadding*/ )
+{
+    ClearAtlas();
+    _atlas = TextureAtlas(pageSize, pageSize, padding);
+
+    // tallest first, the skyline stays flatter
+    std::vector<AnimImage*> shapes(_shapeList.begin(), _shapeList.end());
+    std::stable_sort(shapes.begin(), shapes.end(), [](const AnimImage* a, const AnimImage* b)
+    {
+        return a->GetHeight() * (float)a->GetFramesCount() > b->GetHeight() * (float)b->GetFramesCount();
+    });
+
+    for (auto it = shapes.begin(); it != shapes.end(); ++it)
+    {
+        AnimImage* shape = *it;
+        int width = (int)shape->GetWidth() + padding, height = (int)shape->GetHeight() + padding;
+        int frames = std::max(shape->GetFramesCount(), 1);
+
+        // frames go into a block as square as possible, so they share a page
+        int columns = (int)ceilf(sqrtf((float)frames));
+        int rows = (frames + columns - 1) / columns;
+        TextureAtlas::Region region;
+        if (!_atlas.Add(columns * width - padding, rows * height - padding, region))
+        {
+            TLFXLOG(EFFECTS, ("shape %s doesn't fit on an atlas page", shape->GetName()));
+            ClearAtlas();
+            return false;
+        }
+
+        for (int frame = 0; frame < frames; ++frame)
+            shape->SetAtlasFrame(frame, region.page, region.x + (frame % columns) * width, region.y + (frame / columns) * height, pageSize, pageSize);
+    }
+
+    if (!CreateAtlasPages(_atlas))
+    {
+        ClearAtlas();
+        return false;
+    }
+
+    TLFXLOG(EFFECTS, ("atlas: %d shapes on %d pages, %d%% used", (int)shapes.size(), _atlas.GetPageCount(), (int)(_atlas.GetOccupancy() * 100)));
+    return true;
+}
+
+void EffectsLibrary::ClearAtlas()
+{
+    if (_atlas.GetPageCount() > 0)
+        DestroyAtlasPages();
+    _atlas.Clear();
+
+    for (auto it = _shapeList.begin(); it != _shapeList.end(); ++it)
+        (*it)->ClearAtlas();
+}
+
+const TextureAtlas& EffectsLibrary::GetAtlas() const
+{
+    return _atlas;
+}
+
+const std::list<AnimImage*>& EffectsLibrary::GetShapes() const
+{
+    return _shapeList;
+}
+
+void EffectsLibrary::SetTaskScheduler( TaskScheduler* scheduler )
+{
+    _scheduler = scheduler;
+}
+
+TaskScheduler* EffectsLibrary::GetTaskScheduler() const
+{
+    return _scheduler ? _scheduler : TaskScheduler::GetDefault();
+}
+
 void EffectsLibrary::AddEffect( Effect *e )
 {
     std::string name = e->GetPath();
@@ -181,6 +372,9 @@ void EffectsLibrary::ClearAll()
         delete it->second;
     _emitters.clear();
 
+    _curvePool.Clear();
+
+    ClearAtlas();
     for (auto it = _shapeList.begin(); it != _shapeList.end(); ++it)
         delete *it;
     _shapeList.clear();
@@ -202,46 +396,93 @@ Emitter* EffectsLibrary::GetEmitter( const char *name ) const
     return NULL;
 }
 
+TimeContext& EffectsLibrary::GetDefaultTimeContext()
+{
+    return _defaultTimeContext;
+}
+
 void EffectsLibrary::SetUpdateFrequency( float freq )
 {
-    _updateFrequency = freq;
-    _updateTime = 1000.f / _updateFrequency;
-    _currentUpdateTime = _updateFrequency;
+    _defaultTimeContext.SetUpdateFrequency(freq);
 }
 
 float EffectsLibrary::GetUpdateFrequency()
 {
-    return _updateFrequency;
+    return _defaultTimeContext.GetUpdateFrequency();
 }
 
 float EffectsLibrary::GetUpdateTime()
 {
-    return _updateTime;
+    return _defaultTimeContext.GetUpdateTime();
 }
 
 float EffectsLibrary::GetCurrentUpdateTime()
 {
-    return _currentUpdateTime;
+    return _defaultTimeContext.GetCurrentUpdateTime();
 }
 
 void EffectsLibrary::SetLookupFrequency( float freq )
 {
-    _lookupFrequency = freq;
+    assert(freq > 0);
+    _compileSettings.lookupFrequency = freq;
+    _compileSettings.invLookupFrequency = 1.0f / freq;
 }
 
 float EffectsLibrary::GetLookupFrequency()
 {
-    return _lookupFrequency;
+    return _compileSettings.lookupFrequency;
+}
+
+float EffectsLibrary::GetInvLookupFrequency()
+{
+    return _compileSettings.invLookupFrequency;
 }
 
 void EffectsLibrary::SetLookupFrequencyOverTime( float freq )
 {
-    _lookupFrequencyOverTime = freq;
+    assert(freq > 0);
+    _compileSettings.lookupFrequencyOverTime = freq;
+    _compileSettings.invLookupFrequencyOverTime = 1.0f / freq;
 }
 
 float EffectsLibrary::GetLookupFrequencyOverTime()
 {
-    return _lookupFrequencyOverTime;
+    return _compileSettings.lookupFrequencyOverTime;
+}
+
+float EffectsLibrary::GetInvLookupFrequencyOverTime()
+{
+    return _compileSettings.invLookupFrequencyOverTime;
+}
+
+void EffectsLibrary::SetCompileTolerance( float tolerance )
+{
+    _compileSettings.tolerance = tolerance;
+}
+
+float EffectsLibrary::GetCompileTolerance()
+{
+    return _compileSettings.tolerance;
+}
+
+void EffectsLibrary::SetCompileQuantized( bool value )
+{
+    _compileSettings.quantized = value;
+}
+
+bool EffectsLibrary::GetCompileQuantized()
+{
+    return _compileSettings.quantized;
+}
+
+void EffectsLibrary::SetAttributeCacheSize( int frames )
+{
+    _compileSettings.attributeCacheSize = frames;
+}
+
+int EffectsLibrary::GetAttributeCacheSize()
+{
+    return _compileSettings.attributeCacheSize;
 }
 
 bool EffectsLibrary::AddSprite( AnimImage *sprite )
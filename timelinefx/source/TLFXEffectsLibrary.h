@@ -19,9 +19,15 @@
 #define _TLFX_EFFECTSLIBRARY_H
 
 #include "TLFXXMLLoader.h"
+#include "TLFXTimeContext.h"
+#include "TLFXTaskScheduler.h"
+#include "TLFXCurvePool.h"
+#include "TLFXTextureAtlas.h"
+#include "TLFXAnimImage.h"
 
 #include <map>
 #include <list>
+#include <vector>
 #include <string>
 
 //#define MARMALADE_DEBUG_TRACE 
@@ -48,6 +54,28 @@ namespace TLFX
     {
     public:
 
+        /**
+         * Settings effects are compiled with, see #SetLookupFrequency, #SetLookupFrequencyOverTime, #SetCompileTolerance,
+         * #SetCompileQuantized and #SetAttributeCacheSize
+         * They are kept once here instead of in the #TimeContext of every particle manager. The lookup frequencies are also read while
+         * updating, to find the frame of the compiled tables, so every manager has to use the ones the tables were compiled with.
+         */
+        struct CompileSettings
+        {
+            CompileSettings()
+                : lookupFrequency(1000.0f / 30.0f), lookupFrequencyOverTime(1.0f)
+                , invLookupFrequency(1.0f / (1000.0f / 30.0f)), invLookupFrequencyOverTime(1.0f)
+                , tolerance(0.001f), quantized(false), attributeCacheSize(32) {}
+
+            float   lookupFrequency;            // milliseconds per frame of base, variation and global tables
+            float   lookupFrequencyOverTime;    // milliseconds per frame of over time tables
+            float   invLookupFrequency;
+            float   invLookupFrequencyOverTime;
+            float   tolerance;                  // relative to the range of values of each attribute
+            bool    quantized;
+            int     attributeCacheSize;         // frames
+        };
+
         enum Time
         {
             TimeContinuous,
@@ -133,11 +161,99 @@ namespace TLFX
         EffectsLibrary();
         virtual ~EffectsLibrary();
 
+        /**
+         * Load an effects library
+         * When compile is true all effects are compiled and identical curves are shared, see #ShareCurves.
+         */
         bool Load(const char *filename, bool compile = true);
 
+        /**
+         * Share identical curves between all effects and emitters in the library
+         * <p>Curves with the same attribute nodes and compile parameters are merged into one compiled table owned by the library, see #CurvePool.
+         * #Load does this after compiling. Call it yourself after compiling effects added with #AddEffect, before creating any copies
+         * of them. Shared curves can't be edited any more, so don't call this when you change effects after loading them.</p>
+         * @return a summary of the merged curves and memory saved
+         */
+        std::string ShareCurves();
+
+        const CurvePool& GetCurvePool() const;
+
+        /**
+         * Set whether the library keeps only what playing effects needs
+         * <p>Off by default. When on, #Load releases the authoring data once effects are compiled and their curves shared: the attribute
+         * nodes of every curve and the sub effect and emitter directories of every effect, see #ReleaseAuthoringData. Meant for builds
+         * that never edit effects at runtime. Curves can't be recompiled or interpolated afterwards, and Effect::GetEffect and
+         * Effect::GetEmitter find nothing, use #GetEffect and #GetEmitter of the library instead.</p>
+         */
+        void SetRuntimeOnly(bool value);
+        bool IsRuntimeOnly() const;
+
+        /**
+         * Release the authoring data of a compiled library now, see #SetRuntimeOnly
+         * @return the memory taken by curves and directories before and after
+         */
+        std::string ReleaseAuthoringData();
+
+        /**
+         * Set the size of the atlas pages #Load packs the shapes into
+         * 0 (the default) leaves every shape in its own texture, see #BuildAtlas.
+         */
+        void SetAtlasPageSize(int size);
+        int GetAtlasPageSize() const;
+
+        /**
+         * Pack the frames of all shapes into atlas pages
+         * <p>Every shape goes on a page with all its animation frames, shapes are packed largest first. The place of every frame is
+         * stored with its shape, see AnimImage::GetFrameUV, then #CreateAtlasPages has the integration copy the frames into page textures.
+         * Sprites drawn from the same page can be batched together whatever shape they are, so a whole library draws with as many
+         * batches as it has pages and blend modes.</p>
+         * <p>#Load calls this when #SetAtlasPageSize is set, tools can also call it offline and save the pages.</p>
+         * @return false if a shape is larger than a page or the integration couldn't create the pages, shapes are then left in their own textures
+         */
+        bool BuildAtlas(int pageSize = TextureAtlas::defaultPageSize, int padding = TextureAtlas::defaultPadding);
+
+        /**
+         * Take all shapes out of the atlas, back to their own textures
+         */
+        void ClearAtlas();
+
+        const TextureAtlas& GetAtlas() const;
+        const std::list<AnimImage*>& GetShapes() const;
+
+        /**
+         * Set the alpha threshold #Load trims the shapes with
+         * -1 (the default) leaves every frame a full quad, see #TrimShapes.
+         */
+        void SetTrimThreshold(int threshold);
+        int GetTrimThreshold() const;
+
+        /**
+         * Trim the frames of all shapes to the outline of their pixels with alpha above threshold
+         * <p>Renderers drawing AnimImage::GetFrameHull instead of the full quad skip the transparent parts of soft shapes, which saves
+         * most of the fill rate of large overlapping smoke particles. See AnimImage::BuildHulls.</p>
+         * <p>#Load calls this when #SetTrimThreshold is set.</p>
+         * @return false if the integration can't read the pixels of a shape, see AnimImage::Trim
+         */
+        bool TrimShapes(int threshold, int vertices = AnimImage::maxHullVertices);
+
+        /**
+         * Set the task scheduler used by #Load to compile effects in parallel
+         * The scheduler is not owned by the library. Pass NULL (the default) to use TaskScheduler::GetDefault.
+         */
+        void SetTaskScheduler(TaskScheduler* scheduler);
+        TaskScheduler* GetTaskScheduler() const;
+
+        /**
+         * Get the default time context
+         * Every #ParticleManager takes a copy of this context when it is created, so #SetUpdateFrequency only affects managers
+         * created afterwards. Use ParticleManager::GetTimeContext to change the timing of an existing manager.
+         */
+        static TimeContext& GetDefaultTimeContext();
+
         /**
          * Set the current Update Frequency.
-         * the default update frequency is 30 times per second
+         * the default update frequency is 30 times per second. This sets the default time context, so it only affects particle managers
+         * created after the call, see #GetDefaultTimeContext.
          */
         static void SetUpdateFrequency(float freq);
         static float GetUpdateFrequency();
@@ -148,17 +264,47 @@ namespace TLFX
          * Set the lookup frequency for base, variation and global attributes
          * Default is 30 times per second. This means that the lookup tables for attribute nodes will be accurate to 30 milliseconds
          * which should be accurate enough.
+         * <p>The frequency is library wide and read by every particle manager, set it before loading or compiling effects.</p>
          */
         static void SetLookupFrequency(float freq);
         static float GetLookupFrequency();
+        static float GetInvLookupFrequency();
 
         /**
          * Set the lookup frequency for overtime attributes
          * Default is 1 time per second. This means that the lookup tables for attribute nodes will be accurate to 1 millisecond which is as accurate as it can be. Higher
          * values will save memory but effect will judder more and be less accurate the higher you go. The memory foot print is very small so 1 should be fine for 99% of apps.
+         * <p>Like #SetLookupFrequency it is library wide, set it before loading or compiling effects.</p>
          */
         static void SetLookupFrequencyOverTime(float freq);
         static float GetLookupFrequencyOverTime();
+        static float GetInvLookupFrequencyOverTime();
+
+        /**
+         * Set the maximum error of compiled attribute tables
+         * The error is relative to the range of values of each attribute, the default is 0.001. Compiled tables only keep the points needed
+         * to stay within this error, so straight fades and constant attributes take a couple of floats instead of one per lookup frame.
+         * Set it to 0 to compile a point for every lookup frame.
+         */
+        static void SetCompileTolerance(float tolerance);
+        static float GetCompileTolerance();
+
+        /**
+         * Quantize compiled attribute tables
+         * Off by default. When on, color and alpha tables are stored with 8 bits per value and all other tables with 16 bits, see
+         * EmitterArray::SetStorage. This takes a quarter or half the memory, for a precision that is still finer than what is drawn.
+         */
+        static void SetCompileQuantized(bool value);
+        static bool GetCompileQuantized();
+
+        /**
+         * Set the number of frames the attributes of an effect or emitter are cached for
+         * <p>Every compiled library effect and emitter keeps the attributes its copies look up each update (amount, life, size, speed and
+         * so on) for the last frames used, so copies at the same frame share one lookup, see AttributeCache. The cache holds one frame
+         * for each integer frame modulo this size. 32 by default, 0 turns caching off. Takes effect when effects are compiled.</p>
+         */
+        static void SetAttributeCacheSize(int frames);
+        static int GetAttributeCacheSize();
 
         /**
          * Add a new effect to the library including any sub effects and emitters.
@@ -206,6 +352,19 @@ namespace TLFX
         virtual XMLLoader* CreateLoader() const = 0;
         virtual AnimImage* CreateImage() const = 0;
 
+        /**
+         * Create the page textures of the atlas and copy the frames of every shape into them
+         * <p>Called by #BuildAtlas once every shape has its place, see AnimImage::GetAtlasPage and AnimImage::GetAtlasFramePosition for
+         * where frames go and AnimImage::GetFrameSource for where they come from. The default has no textures to create and fails.</p>
+         */
+        virtual bool CreateAtlasPages(const TextureAtlas& /*atlas*/) { return false; }
+
+        /**
+         * Free the page textures, called by #ClearAtlas
+         * The library destructor can't reach overrides, so integrations also free their pages in their own destructor.
+         */
+        virtual void DestroyAtlasPages() {}
+
 #ifdef _DEBUG
         static int particlesCreated;
 #endif
@@ -215,12 +374,15 @@ namespace TLFX
         std::map<std::string, Emitter*> _emitters;
         std::string                     _name;
         std::list<AnimImage*>           _shapeList;
-
-        static float                    _updateFrequency;                  //  times per second
-        static float                    _updateTime;
-        static float                    _currentUpdateTime;
-        static float                    _lookupFrequency;
-        static float                    _lookupFrequencyOverTime;
+        TaskScheduler*                  _scheduler;
+        CurvePool                       _curvePool;
+        bool                            _runtimeOnly;
+        int                             _atlasPageSize;
+        int                             _trimThreshold;
+        TextureAtlas                    _atlas;
+
+        static TimeContext              _defaultTimeContext;
+        static CompileSettings          _compileSettings;
     };
 
 } // namespace TLFX
@@ -4,10 +4,12 @@
 #include "TLFXAnimImage.h"
 #include "TLFXParticleManager.h"
 #include "TLFXParticle.h"
+#include "TLFXCurvePool.h"
 
 #include <algorithm>
 #include <cmath>
 #include <cassert>
+#include <cstdlib>
 
 namespace TLFX
 {
@@ -62,6 +64,7 @@ namespace TLFX
         , _bypassFramerate(false)
         , _bypassStretch(false)
         , _bypassSplatter(false)
+        , _controlKernel(GetControlKernel(controlAll))
 
         , _AABB_ParticleMaxWidth(0)
         , _AABB_ParticleMaxHeight(0)
@@ -84,7 +87,11 @@ namespace TLFX
         , _currentSizeYVariation(0)
         , _currentFramerate(0)
 
+        , _randomSeed(0)
+
         , _arrayOwner(true)
+        , _packedColor(NULL)
+        , _sharedAttributeCache(NULL)
     {
         _childrenOwner = false;         // the Particles are managing by pool
 
@@ -173,6 +180,7 @@ namespace TLFX
         , _bypassFramerate(o._bypassFramerate)
         , _bypassStretch(o._bypassStretch)
         , _bypassSplatter(o._bypassSplatter)
+        , _controlKernel(o._controlKernel)
 
         , _AABB_ParticleMaxWidth(o._AABB_ParticleMaxWidth)
         , _AABB_ParticleMaxHeight(o._AABB_ParticleMaxHeight)
@@ -195,6 +203,8 @@ namespace TLFX
         , _currentSizeYVariation(o._currentSizeYVariation)
         , _currentFramerate(o._currentFramerate)
 
+        , _randomSeed((unsigned int)rand())     // every instance gets its own particle sequences
+
         , _path(o._path)
 
         , _arrayOwner(false)                // this copy (instance) is not owner
@@ -231,10 +241,13 @@ namespace TLFX
         , _cFramerate(o._cFramerate)
         , _cStretch(o._cStretch)
         , _cSplatter(o._cSplatter)
+        , _packedColor(o._packedColor)      // the library emitter keeps the table
+        , _sharedAttributeCache(o._sharedAttributeCache)
 
         // copy automatically: base/entity
         // not copy: 
     {
+        SetTimeContext(&pm->GetTimeContext());
         _dob = pm->GetCurrentTime();
         SetOKtoRender(false);
 
@@ -834,7 +847,11 @@ namespace TLFX
         if (_radiusCalculate)
             base::UpdateEntityRadius();
 
-        UpdateChildren();
+        ParticleManager* pm = _parentEffect->GetParticleManager();
+        if (pm->IsParallelUpdate((int)_children.size()))
+            UpdateParticlesParallel(pm);
+        else
+            UpdateParticles();
 
         if (!_dead && !_dying)
         {
@@ -865,7 +882,10 @@ namespace TLFX
         float curFrame = _parentEffect->GetCurrentEffectFrame();
         ParticleManager* pm = _parentEffect->GetParticleManager();
 
-        qty = ((GetEmitterAmount(curFrame) + Rnd(GetEmitterAmountVariation(curFrame))) * _parentEffect->GetCurrentAmount() * pm->GetGlobalAmountScale() * pm->GetLocalAmountScale()) / EffectsLibrary::GetUpdateFrequency();
+        float attributes[spawnAttributeCount];
+        GetSpawnAttributes(curFrame, attributes);
+
+        qty = ((attributes[attrAmount] + Rnd(attributes[attrAmountVariation])) * _parentEffect->GetCurrentAmount() * pm->GetGlobalAmountScale() * pm->GetLocalAmountScale() * _parentEffect->GetBudgetScale()) * _timeContext->GetInvUpdateFrequency();
         if (!_singleParticle)
             _counter += qty;
         intCounter = (int)_counter;
@@ -888,26 +908,26 @@ namespace TLFX
             }
 
             // preload attributes
-            _currentLife = GetEmitterLife(curFrame) * _parentEffect->GetCurrentLife();
+            _currentLife = attributes[attrLife] * _parentEffect->GetCurrentLife();
             if (!_bypassWeight)
             {
-                _currentWeight = GetEmitterBaseWeight(curFrame);
-                _currentWeightVariation = GetEmitterWeightVariation(curFrame);
+                _currentWeight = attributes[attrBaseWeight];
+                _currentWeightVariation = attributes[attrWeightVariation];
             }
 
             if (!_bypassSpeed)
             {
-                _currentSpeed = GetEmitterBaseSpeed(curFrame);
-                _currentSpeedVariation = GetEmitterVelVariation(curFrame);
+                _currentSpeed = attributes[attrBaseSpeed];
+                _currentSpeedVariation = attributes[attrVelVariation];
             }
 
             if (!_bypassSpin)
             {
-                _currentSpin = GetEmitterBaseSpin(curFrame);
-                _currentSpinVariation = GetEmitterSpinVariation(curFrame);
+                _currentSpin = attributes[attrBaseSpin];
+                _currentSpinVariation = attributes[attrSpinVariation];
             }
 
-            _currentDirectionVariation = GetEmitterDirectionVariation(curFrame);
+            _currentDirectionVariation = attributes[attrDirectionVariation];
 
             if (_useEffectEmission)
             {
@@ -916,15 +936,15 @@ namespace TLFX
             }
             else
             {
-                er = GetEmitterEmissionRange(curFrame);
-                _currentEmissionAngle = GetEmitterEmissionAngle(curFrame);
+                er = attributes[attrEmissionRange];
+                _currentEmissionAngle = attributes[attrEmissionAngle];
             }
 
-            _currentLifeVariation = GetEmitterLifeVariation(curFrame);
-            _currentSizeX = GetEmitterSizeX(curFrame);
-            _currentSizeY = GetEmitterSizeY(curFrame);
-            _currentSizeXVariation = GetEmitterSizeXVariation(curFrame);
-            _currentSizeYVariation = GetEmitterSizeYVariation(curFrame);
+            _currentLifeVariation = attributes[attrLifeVariation];
+            _currentSizeX = attributes[attrSizeX];
+            _currentSizeY = attributes[attrSizeY];
+            _currentSizeXVariation = attributes[attrSizeXVariation];
+            _currentSizeYVariation = attributes[attrSizeYVariation];
 
             // ------------------------------
             for (int c = 1; c <= intCounter; ++c)
@@ -953,6 +973,8 @@ namespace TLFX
                     e->SetParent(this);
                     e->SetParticleManager(pm);
                     e->SetEffectLayer(_parentEffect->GetEffectLayer());
+                    _randomSeed = _randomSeed * 1664525u + 1013904223u;
+                    e->SetRandomSeed(_randomSeed);
                     // ----------------------------------------------------
                     e->SetDoB(pm->GetCurrentTime());
 
@@ -1512,11 +1534,97 @@ namespace TLFX
 
     void Emitter::ControlParticle( Particle *e )
     {
+        ControlParticles(&e, 1);
+    }
+
+    void Emitter::ControlParticles( Particle **particles, int count )
+    {
+        (this->*_controlKernel)(particles, count);
+    }
+
+    template<unsigned int features>
+    void Emitter::ControlParticlesFor( Particle **particles, int count )
+    {
+        ControlBatch batch;
+        batch.globalVelocity = (features & controlSpeed) ? GetEmitterGlobalVelocity(_parentEffect->GetCurrentEffectFrame()) : 0;
+
+        for (int begin = 0; begin < count; begin += controlBatchSize)
+        {
+            int n = std::min(count - begin, (int)controlBatchSize);
+            for (int i = 0; i < n; ++i)
+            {
+                batch.age[i] = particles[begin + i]->_age;
+                batch.lifetime[i] = (float)particles[begin + i]->_lifeTime;
+            }
+
+            // only the attributes ControlParticle is going to use
+            if ((!(features & controlColor) || !_packedColor) && _alphaRepeat <= 1)
+                _cAlpha->EvaluateOT(batch.age, batch.lifetime, batch.alpha, n);
+            if ((features & controlColor) && !_packedColor && !_randomColor && _colorRepeat <= 1)
+            {
+                _cR->EvaluateOT(batch.age, batch.lifetime, batch.red, n);
+                _cG->EvaluateOT(batch.age, batch.lifetime, batch.green, n);
+                _cB->EvaluateOT(batch.age, batch.lifetime, batch.blue, n);
+            }
+            if (features & controlSpin)
+                _cSpin->EvaluateOT(batch.age, batch.lifetime, batch.spin, n);
+            if (!_bypassDirectionvariation)
+                _cDirectionVariationOT->EvaluateOT(batch.age, batch.lifetime, batch.directionVariation, n);
+            _cDirection->EvaluateOT(batch.age, batch.lifetime, batch.direction, n);
+            if ((features & controlScaleX) || !_bypassStretch)
+                _cScaleX->EvaluateOT(batch.age, batch.lifetime, batch.scaleX, n);
+            if (!_bypassScaleY || !_bypassStretch)
+                _cScaleY->EvaluateOT(batch.age, batch.lifetime, batch.scaleY, n);
+            if (features & controlFramerate)
+                _cFramerate->EvaluateOT(batch.age, batch.lifetime, batch.framerate, n);
+            if (features & controlSpeed)
+                _cVelocity->EvaluateOT(batch.age, batch.lifetime, batch.velocity, n);
+            if (!_bypassStretch)
+                _cStretch->EvaluateOT(batch.age, batch.lifetime, batch.stretch, n);
+            if (features & controlWeight)
+                _cWeight->EvaluateOT(batch.age, batch.lifetime, batch.weight, n);
+
+            for (int i = 0; i < n; ++i)
+                ControlParticleFor<features>(particles[begin + i], batch, i);
+        }
+    }
+
+    template<unsigned int features>
+    void Emitter::ControlParticleFor( Particle *e, const ControlBatch& batch, int i )
+    {
+        const TimeContext& time = *_timeContext;
 
+        // alpha and color change together, from the packed table
+        if ((features & controlColor) && _packedColor)
+        {
+            unsigned int rgba;
+            if (_alphaRepeat > 1)
+            {
+                // color repeats as often, so both repeat ages stay the same
+                e->_rptAgeA += time.GetCurrentUpdateTime() * _alphaRepeat;
+                rgba = GetPackedColor(e->_rptAgeA, (float)e->_lifeTime);
+                if (e->_rptAgeA > e->_lifeTime && e->_aCycles < _alphaRepeat)
+                {
+                    e->_rptAgeA -= e->_lifeTime;
+                    ++e->_aCycles;
+                }
+                e->_rptAgeC = e->_rptAgeA;
+                e->_cCycles = e->_aCycles;
+            }
+            else
+            {
+                rgba = GetPackedColor(e->_age, (float)e->_lifeTime);
+            }
+
+            e->_red = (unsigned char)rgba;
+            e->_green = (unsigned char)(rgba >> 8);
+            e->_blue = (unsigned char)(rgba >> 16);
+            e->_alpha = (rgba >> 24) * (1.0f / 255.0f) * _parentEffect->GetCurrentAlpha();
+        }
         // alpha change
-        if (_alphaRepeat > 1)
+        else if (_alphaRepeat > 1)
         {
-            e->_rptAgeA += EffectsLibrary::GetCurrentUpdateTime() * _alphaRepeat;
+            e->_rptAgeA += time.GetCurrentUpdateTime() * _alphaRepeat;
             e->_alpha = GetEmitterAlpha(e->_rptAgeA, (float)e->_lifeTime) * _parentEffect->GetCurrentAlpha();
             if (e->_rptAgeA > e->_lifeTime && e->_aCycles < _alphaRepeat)
             {
@@ -1526,7 +1634,7 @@ namespace TLFX
         }
         else
         {
-            e->_alpha = GetEmitterAlpha(e->_age, (float)e->_lifeTime) * _parentEffect->GetCurrentAlpha();
+            e->_alpha = batch.alpha[i] * _parentEffect->GetCurrentAlpha();
         }
 
         // angle changes
@@ -1538,7 +1646,7 @@ namespace TLFX
             }
             else
             {
-                if (!_bypassWeight && (!_parentEffect->IsBypassWeight() || e->_direction))
+                if ((features & controlWeight) && (!_parentEffect->IsBypassWeight() || e->_direction))
                 {
                     if (e->_oldWX != e->_wx && e->_oldWY != e->_wy)
                     {
@@ -1564,8 +1672,8 @@ namespace TLFX
         }
         else
         {
-            if (!_bypassSpin)
-                e->_angle += (GetEmitterSpin(e->_age, (float)e->_lifeTime) * e->_spinVariation * _parentEffect->GetCurrentSpin()) / EffectsLibrary::GetCurrentUpdateTime();
+            if (features & controlSpin)
+                e->_angle += (batch.spin[i] * e->_spinVariation * _parentEffect->GetCurrentSpin()) * time.GetInvCurrentUpdateTime();
         }
 
         // direction changes and motion randomness
@@ -1620,44 +1728,44 @@ namespace TLFX
         {
             if (!_bypassDirectionvariation)
             {
-                float dv = e->_directionVariation * GetEmitterDirectionVariationOT(e->_age, (float)e->_lifeTime);
-                e->_timeTracker += (int)EffectsLibrary::GetUpdateTime();
+                float dv = e->_directionVariation * batch.directionVariation[i];
+                e->_timeTracker += (int)time.GetUpdateTime();
                 if (e->_timeTracker > EffectsLibrary::motionVariationInterval)
                 {
-                    e->_randomDirection += EffectsLibrary::maxDirectionVariation * Rnd(-dv, dv);
-                    e->_randomSpeed += EffectsLibrary::maxVelocityVariation * Rnd(-dv, dv);
+                    e->_randomDirection += EffectsLibrary::maxDirectionVariation * e->RndVariation(-dv, dv);
+                    e->_randomSpeed += EffectsLibrary::maxVelocityVariation * e->RndVariation(-dv, dv);
                     e->_timeTracker = 0;
                 }
             }
-            e->_direction = e->_emissionAngle + GetEmitterDirection(e->_age, (float)e->_lifeTime) + e->_randomDirection;
+            e->_direction = e->_emissionAngle + batch.direction[i] + e->_randomDirection;
         }
 
         // size changes
-        if (!_bypassScaleX)
+        if (features & controlScaleX)
         {
-            e->_scaleX = (GetEmitterScaleX(e->_age, (float)e->_lifeTime) * e->_gSizeX * e->_width) / _image->GetWidth();
+            e->_scaleX = (batch.scaleX[i] * e->_gSizeX * e->_width) / _image->GetWidth();
         }
         if (_uniform)
         {
-            if (!_bypassScaleX)
+            if (features & controlScaleX)
                 e->_scaleY = e->_scaleX;
         }
         else
         {
             if (!_bypassScaleY)
             {
-                e->_scaleY = (GetEmitterScaleY(e->_age, (float)e->_lifeTime) * e->_gSizeY * e->_height) / _image->GetHeight();
+                e->_scaleY = (batch.scaleY[i] * e->_gSizeY * e->_height) / _image->GetHeight();
             }
         }
 
         // color changes
-        if (!_bypassColor)
+        if ((features & controlColor) && !_packedColor)
         {
             if (!_randomColor)
             {
                 if (_colorRepeat > 1)
                 {
-                    e->_rptAgeC += EffectsLibrary::GetCurrentUpdateTime() * _colorRepeat;
+                    e->_rptAgeC += time.GetCurrentUpdateTime() * _colorRepeat;
                     e->_red = (unsigned char)GetEmitterR(e->_rptAgeC, (float)e->_lifeTime);
                     e->_green = (unsigned char)GetEmitterG(e->_rptAgeC, (float)e->_lifeTime);
                     e->_blue = (unsigned char)GetEmitterB(e->_rptAgeC, (float)e->_lifeTime);
@@ -1669,21 +1777,21 @@ namespace TLFX
                 }
                 else
                 {
-                    e->_red = (unsigned char)GetEmitterR(e->_age, (float)e->_lifeTime);
-                    e->_green = (unsigned char)GetEmitterG(e->_age, (float)e->_lifeTime);
-                    e->_blue = (unsigned char)GetEmitterB(e->_age, (float)e->_lifeTime);
+                    e->_red = (unsigned char)batch.red[i];
+                    e->_green = (unsigned char)batch.green[i];
+                    e->_blue = (unsigned char)batch.blue[i];
                 }
             }
         }
 
         // animation
-        if (!_bypassFramerate)
-            e->_framerate = GetEmitterFramerate(e->_age, (float)e->_lifeTime) * _animationDirection;
+        if (features & controlFramerate)
+            e->_framerate = batch.framerate[i] * _animationDirection;
 
         // speed changes
-        if (!_bypassSpeed)
+        if (features & controlSpeed)
         {
-            e->_speed = GetEmitterVelocity(e->_age, (float)e->_lifeTime) * e->_baseSpeed * GetEmitterGlobalVelocity(_parentEffect->GetCurrentEffectFrame());
+            e->_speed = batch.velocity[i] * e->_baseSpeed * batch.globalVelocity;
             e->_speed += e->_randomSpeed;
         }
         else
@@ -1694,12 +1802,12 @@ namespace TLFX
         // stretch
         if (!_bypassStretch)
         {
-            if (!_bypassWeight && !_parentEffect->IsBypassWeight())
+            if ((features & controlWeight) && !_parentEffect->IsBypassWeight())
             {
                 if (e->_speed != 0)
                 {
-                    e->_speedVec.x = e->_speedVec.x / EffectsLibrary::GetCurrentUpdateTime();
-                    e->_speedVec.y = e->_speedVec.y / EffectsLibrary::GetCurrentUpdateTime() - e->_gravity;
+                    e->_speedVec.x = e->_speedVec.x * time.GetInvCurrentUpdateTime();
+                    e->_speedVec.y = e->_speedVec.y * time.GetInvCurrentUpdateTime() - e->_gravity;
                 }
                 else
                 {
@@ -1708,16 +1816,16 @@ namespace TLFX
                 }
 
                 if (_uniform)
-                    e->_scaleY = (GetEmitterScaleX(e->_age, (float)e->_lifeTime) * e->_gSizeX * (e->_width + (fabsf(e->_speed) * GetEmitterStretch(e->_age, (float)e->_lifeTime) * _parentEffect->GetCurrentStretch()))) / _image->GetWidth();
+                    e->_scaleY = (batch.scaleX[i] * e->_gSizeX * (e->_width + (fabsf(e->_speed) * batch.stretch[i] * _parentEffect->GetCurrentStretch()))) / _image->GetWidth();
                 else
-                    e->_scaleY = (GetEmitterScaleY(e->_age, (float)e->_lifeTime) * e->_gSizeY * (e->_height + (fabsf(e->_speed) * GetEmitterStretch(e->_age, (float)e->_lifeTime) * _parentEffect->GetCurrentStretch()))) / _image->GetHeight();
+                    e->_scaleY = (batch.scaleY[i] * e->_gSizeY * (e->_height + (fabsf(e->_speed) * batch.stretch[i] * _parentEffect->GetCurrentStretch()))) / _image->GetHeight();
             }
             else
             {
                 if (_uniform)
-                    e->_scaleY = (GetEmitterScaleX(e->_age, (float)e->_lifeTime) * e->_gSizeX * (e->_width + (fabsf(e->_speed) * GetEmitterStretch(e->_age, (float)e->_lifeTime) * _parentEffect->GetCurrentStretch()))) / _image->GetWidth();
+                    e->_scaleY = (batch.scaleX[i] * e->_gSizeX * (e->_width + (fabsf(e->_speed) * batch.stretch[i] * _parentEffect->GetCurrentStretch()))) / _image->GetWidth();
                 else
-                    e->_scaleY = (GetEmitterScaleY(e->_age, (float)e->_lifeTime) * e->_gSizeY * (e->_height + (fabsf(e->_speed) * GetEmitterStretch(e->_age, (float)e->_lifeTime) * _parentEffect->GetCurrentStretch()))) / _image->GetHeight();
+                    e->_scaleY = (batch.scaleY[i] * e->_gSizeY * (e->_height + (fabsf(e->_speed) * batch.stretch[i] * _parentEffect->GetCurrentStretch()))) / _image->GetHeight();
             }
 
             if (e->_scaleY < e->_scaleX)
@@ -1725,8 +1833,139 @@ namespace TLFX
         }
 
         // weight changes
-        if (!_bypassWeight)
-            e->_weight = GetEmitterWeight(e->_age, (float)e->_lifeTime) * e->_baseWeight;
+        if (features & controlWeight)
+            e->_weight = batch.weight[i] * e->_baseWeight;
+    }
+
+    template<unsigned int count>
+    struct Emitter::ControlKernelTable
+    {
+        static void Fill(ControlKernel* kernels)
+        {
+            ControlKernelTable<count - 1>::Fill(kernels);
+            kernels[count - 1] = &Emitter::ControlParticlesFor<count - 1>;
+        }
+    };
+
+    template<>
+    struct Emitter::ControlKernelTable<0>
+    {
+        static void Fill(ControlKernel*) {}
+    };
+
+    Emitter::ControlKernel Emitter::GetControlKernel( unsigned int features )
+    {
+        static ControlKernel kernels[controlAll + 1];
+        static bool filled = (ControlKernelTable<controlAll + 1>::Fill(kernels), true);
+        (void)filled;
+
+        assert(features <= controlAll);
+        return kernels[features];
+    }
+
+    void Emitter::SetGenericControl( bool generic )
+    {
+        _controlKernel = GetControlKernel(generic ? (unsigned int)controlAll : GetControlFeatures());
+    }
+
+    bool Emitter::IsGenericControl() const
+    {
+        return _controlKernel == GetControlKernel(controlAll);
+    }
+
+    unsigned int Emitter::GetControlFeatures() const
+    {
+        unsigned int features = 0;
+        if (!_bypassWeight)    features |= controlWeight;
+        if (!_bypassSpeed)     features |= controlSpeed;
+        if (!_bypassSpin)      features |= controlSpin;
+        if (!_bypassColor)     features |= controlColor;
+        if (!_bypassScaleX)    features |= controlScaleX;
+        if (!_bypassFramerate) features |= controlFramerate;
+        return features;
+    }
+
+    void Emitter::UpdateParticles()
+    {
+        // same as UpdateChildren, but the particles without sub effects are controlled together once they all moved
+        _parallelParticles.clear();
+        for (auto it = _children.begin(); it != _children.end(); )
+        {
+            Particle* p = static_cast<Particle*>(*it);
+            bool alive;
+            if (!p->GetChildren().empty())
+            {
+                alive = p->Update();
+            }
+            else
+            {
+                p->UpdateLocal();
+                alive = p->FinishUpdate();
+                if (alive)
+                    _parallelParticles.push_back(p);
+            }
+
+            if (!alive)
+            {
+                if (_childrenOwner) delete *it;
+                it = _children.erase(it);
+            }
+            else
+                ++it;
+        }
+
+        if (!_parallelParticles.empty())
+            ControlParticles(&_parallelParticles[0], (int)_parallelParticles.size());
+    }
+
+    void Emitter::UpdateParticlesParallel( ParticleManager *pm )
+    {
+        // particles with sub effects spawn new particles, they are updated serially below
+        _parallelParticles.clear();
+        for (auto it = _children.begin(); it != _children.end(); ++it)
+        {
+            if ((*it)->GetChildren().empty())
+                _parallelParticles.push_back(static_cast<Particle*>(*it));
+        }
+
+        Particle** particles = _parallelParticles.empty() ? NULL : &_parallelParticles[0];
+        pm->ParallelFor((int)_parallelParticles.size(), [particles](int begin, int end)
+        {
+            for (int i = begin; i < end; ++i)
+                particles[i]->UpdateLocal();
+        });
+
+        // parent bounds, deaths and sub effects in list order
+        _parallelParticles.clear();
+        for (auto it = _children.begin(); it != _children.end(); )
+        {
+            Particle* p = static_cast<Particle*>(*it);
+            bool alive;
+            if (!p->GetChildren().empty())
+            {
+                alive = p->Update();
+            }
+            else
+            {
+                alive = p->FinishUpdate();
+                if (alive)
+                    _parallelParticles.push_back(p);
+            }
+
+            if (!alive)
+            {
+                if (_childrenOwner) delete *it;
+                it = _children.erase(it);
+            }
+            else
+                ++it;
+        }
+
+        particles = _parallelParticles.empty() ? NULL : &_parallelParticles[0];
+        pm->ParallelFor((int)_parallelParticles.size(), [this, particles](int begin, int end)
+        {
+            ControlParticles(particles + begin, end - begin);
+        });
     }
 
     float Emitter::RandomizeR( Particle *e, float randomAge )
@@ -1761,6 +2000,8 @@ namespace TLFX
 
     void Emitter::CompileAll()
     {
+        UnshareArrays();
+
         // base
         _cLife->Compile();
         _cLifeVariation->Compile();
@@ -1805,10 +2046,64 @@ namespace TLFX
         }
 
         AnalyseEmitter();
+
+        if (EffectsLibrary::GetCompileQuantized())
+        {
+            BakeColorTable();
+
+            // color and alpha are drawn with 8 bits anyway
+            _cAlpha->SetStorage(EmitterArray::StorageByte);
+            _cR->SetStorage(EmitterArray::StorageByte);
+            _cG->SetStorage(EmitterArray::StorageByte);
+            _cB->SetStorage(EmitterArray::StorageByte);
+
+            EmitterArray* fixed[] = { _cBaseSpin, _cSpin, _cSpinVariation, _cVelocity, _cBaseWeight, _cWeight, _cWeightVariation, _cBaseSpeed,
+                _cVelVariation, _cSizeX, _cSizeY, _cScaleX, _cScaleY, _cSizeXVariation, _cSizeYVariation, _cLifeVariation, _cLife, _cAmount,
+                _cAmountVariation, _cEmissionAngle, _cEmissionRange, _cGlobalVelocity, _cDirection, _cDirectionVariation, _cDirectionVariationOT,
+                _cFramerate, _cStretch, _cSplatter };
+            for (size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); ++i)
+                fixed[i]->SetStorage(EmitterArray::StorageShort);
+        }
+
+        // cached values are out of date
+        _attributeCache.Reset(spawnAttributeCount, EffectsLibrary::GetAttributeCacheSize());
+        _sharedAttributeCache = _attributeCache.IsEnabled() ? &_attributeCache : NULL;
+    }
+
+    void Emitter::GetSpawnAttributes( float frame, float* values ) const
+    {
+        if (_sharedAttributeCache && _sharedAttributeCache->Get(frame, values))
+            return;
+
+        values[attrAmount]             = GetEmitterAmount(frame);
+        values[attrAmountVariation]    = GetEmitterAmountVariation(frame);
+        values[attrLife]               = GetEmitterLife(frame);
+        values[attrLifeVariation]      = GetEmitterLifeVariation(frame);
+        values[attrBaseWeight]         = GetEmitterBaseWeight(frame);
+        values[attrWeightVariation]    = GetEmitterWeightVariation(frame);
+        values[attrBaseSpeed]          = GetEmitterBaseSpeed(frame);
+        values[attrVelVariation]       = GetEmitterVelVariation(frame);
+        values[attrBaseSpin]           = GetEmitterBaseSpin(frame);
+        values[attrSpinVariation]      = GetEmitterSpinVariation(frame);
+        values[attrDirectionVariation] = GetEmitterDirectionVariation(frame);
+        values[attrEmissionRange]      = GetEmitterEmissionRange(frame);
+        values[attrEmissionAngle]      = GetEmitterEmissionAngle(frame);
+        values[attrSizeX]              = GetEmitterSizeX(frame);
+        values[attrSizeY]              = GetEmitterSizeY(frame);
+        values[attrSizeXVariation]     = GetEmitterSizeXVariation(frame);
+        values[attrSizeYVariation]     = GetEmitterSizeYVariation(frame);
+
+        if (_sharedAttributeCache)
+            _sharedAttributeCache->Set(frame, values);
     }
 
     void Emitter::CompileQuick()
     {
+        UnshareArrays();
+
+        std::vector<unsigned int>().swap(_colorTable);
+        _packedColor = NULL;
+
         float longestLife = GetLongestLife();
 
         _cAlpha->Clear(1);
@@ -1848,6 +2143,93 @@ namespace TLFX
         _cSplatter->SetCompiled(0, GetEmitterSplatter(0));
     }
 
+    void Emitter::ShareArrays( CurvePool& pool )
+    {
+        if (_arrayOwner)
+        {
+            _cR = pool.Share(_cR);
+            _cG = pool.Share(_cG);
+            _cB = pool.Share(_cB);
+            _cBaseSpin = pool.Share(_cBaseSpin);
+            _cSpin = pool.Share(_cSpin);
+            _cSpinVariation = pool.Share(_cSpinVariation);
+            _cVelocity = pool.Share(_cVelocity);
+            _cBaseWeight = pool.Share(_cBaseWeight);
+            _cWeight = pool.Share(_cWeight);
+            _cWeightVariation = pool.Share(_cWeightVariation);
+            _cBaseSpeed = pool.Share(_cBaseSpeed);
+            _cVelVariation = pool.Share(_cVelVariation);
+            _cAlpha = pool.Share(_cAlpha);
+            _cSizeX = pool.Share(_cSizeX);
+            _cSizeY = pool.Share(_cSizeY);
+            _cScaleX = pool.Share(_cScaleX);
+            _cScaleY = pool.Share(_cScaleY);
+            _cSizeXVariation = pool.Share(_cSizeXVariation);
+            _cSizeYVariation = pool.Share(_cSizeYVariation);
+            _cLifeVariation = pool.Share(_cLifeVariation);
+            _cLife = pool.Share(_cLife);
+            _cAmount = pool.Share(_cAmount);
+            _cAmountVariation = pool.Share(_cAmountVariation);
+            _cEmissionAngle = pool.Share(_cEmissionAngle);
+            _cEmissionRange = pool.Share(_cEmissionRange);
+            _cGlobalVelocity = pool.Share(_cGlobalVelocity);
+            _cDirection = pool.Share(_cDirection);
+            _cDirectionVariation = pool.Share(_cDirectionVariation);
+            _cDirectionVariationOT = pool.Share(_cDirectionVariationOT);
+            _cFramerate = pool.Share(_cFramerate);
+            _cStretch = pool.Share(_cStretch);
+            _cSplatter = pool.Share(_cSplatter);
+            _arrayOwner = false;            // the pool owns them now
+        }
+
+        // sub effects
+        for (auto it = _effects.begin(); it != _effects.end(); ++it)
+        {
+            (*it)->ShareArrays(pool);
+        }
+    }
+
+    void Emitter::UnshareArrays()
+    {
+        // the pool keeps its arrays for the other emitters sharing them
+        if (_arrayOwner || !_cLife->IsPooled())
+            return;
+
+        _cR = CurvePool::Unshare(_cR);
+        _cG = CurvePool::Unshare(_cG);
+        _cB = CurvePool::Unshare(_cB);
+        _cBaseSpin = CurvePool::Unshare(_cBaseSpin);
+        _cSpin = CurvePool::Unshare(_cSpin);
+        _cSpinVariation = CurvePool::Unshare(_cSpinVariation);
+        _cVelocity = CurvePool::Unshare(_cVelocity);
+        _cBaseWeight = CurvePool::Unshare(_cBaseWeight);
+        _cWeight = CurvePool::Unshare(_cWeight);
+        _cWeightVariation = CurvePool::Unshare(_cWeightVariation);
+        _cBaseSpeed = CurvePool::Unshare(_cBaseSpeed);
+        _cVelVariation = CurvePool::Unshare(_cVelVariation);
+        _cAlpha = CurvePool::Unshare(_cAlpha);
+        _cSizeX = CurvePool::Unshare(_cSizeX);
+        _cSizeY = CurvePool::Unshare(_cSizeY);
+        _cScaleX = CurvePool::Unshare(_cScaleX);
+        _cScaleY = CurvePool::Unshare(_cScaleY);
+        _cSizeXVariation = CurvePool::Unshare(_cSizeXVariation);
+        _cSizeYVariation = CurvePool::Unshare(_cSizeYVariation);
+        _cLifeVariation = CurvePool::Unshare(_cLifeVariation);
+        _cLife = CurvePool::Unshare(_cLife);
+        _cAmount = CurvePool::Unshare(_cAmount);
+        _cAmountVariation = CurvePool::Unshare(_cAmountVariation);
+        _cEmissionAngle = CurvePool::Unshare(_cEmissionAngle);
+        _cEmissionRange = CurvePool::Unshare(_cEmissionRange);
+        _cGlobalVelocity = CurvePool::Unshare(_cGlobalVelocity);
+        _cDirection = CurvePool::Unshare(_cDirection);
+        _cDirectionVariation = CurvePool::Unshare(_cDirectionVariation);
+        _cDirectionVariationOT = CurvePool::Unshare(_cDirectionVariationOT);
+        _cFramerate = CurvePool::Unshare(_cFramerate);
+        _cStretch = CurvePool::Unshare(_cStretch);
+        _cSplatter = CurvePool::Unshare(_cSplatter);
+        _arrayOwner = true;
+    }
+
     void Emitter::AnalyseEmitter()
     {
         ResetBypassers();
@@ -1879,7 +2261,8 @@ namespace TLFX
         if (!_cDirectionVariation->GetLastFrame() && !GetEmitterDirectionVariation(0))
             _bypassDirectionvariation = true;
 
-        if (_cR->GetAttributesCount() <= 1)
+        // attributes that don't change over the particle's life keep the value set when the particle spawns
+        if (_cR->GetAttributesCount() <= 1 || (_cR->IsConstant() && _cG->IsConstant() && _cB->IsConstant()))
         {
             _bRed = GetEmitterR(0, 1.0f) != 0;             // @todo dan ???
             _bGreen = GetEmitterG(0, 1.0f) != 0;
@@ -1887,11 +2270,49 @@ namespace TLFX
             _bypassColor = true;
         }
 
-        if (_cScaleX->GetAttributesCount() <= 1)
+        if (_cScaleX->GetAttributesCount() <= 1 || _cScaleX->IsConstant())
             _bypassScaleX = true;
 
-        if (_cScaleY->GetAttributesCount() <= 1)
+        if (_cScaleY->GetAttributesCount() <= 1 || _cScaleY->IsConstant())
             _bypassScaleY = true;
+
+        _controlKernel = GetControlKernel(GetControlFeatures());
+    }
+
+    void Emitter::BakeColorTable()
+    {
+        std::vector<unsigned int>().swap(_colorTable);
+        _packedColor = NULL;
+
+        // alpha and color have to change over the same age for a single lookup
+        if (_bypassColor || _randomColor || std::max(_colorRepeat, 1) != std::max(_alphaRepeat, 1))
+            return;
+
+        _colorTable.resize(colorTableSize);
+        for (int i = 0; i < colorTableSize; ++i)
+        {
+            float age = (float)i, lifetime = (float)(colorTableSize - 1);
+            unsigned int r = (unsigned char)GetEmitterR(age, lifetime);
+            unsigned int g = (unsigned char)GetEmitterG(age, lifetime);
+            unsigned int b = (unsigned char)GetEmitterB(age, lifetime);
+            float alpha = std::min(std::max(GetEmitterAlpha(age, lifetime), 0.0f), 1.0f);
+            unsigned int a = (unsigned int)(alpha * 255.0f + 0.5f);
+            _colorTable[i] = r | (g << 8) | (b << 16) | (a << 24);
+        }
+        _packedColor = &_colorTable[0];
+    }
+
+    bool Emitter::IsColorTableBaked() const
+    {
+        return _packedColor != NULL;
+    }
+
+    unsigned int Emitter::GetPackedColor( float age, float lifetime ) const
+    {
+        assert(_packedColor);
+
+        float index = lifetime > 0 ? age / lifetime * (colorTableSize - 1) + 0.5f : 0;
+        return _packedColor[index < colorTableSize - 1 ? (index > 0 ? (int)index : 0) : colorTableSize - 1];
     }
 
     void Emitter::ResetBypassers()
@@ -1910,6 +2331,8 @@ namespace TLFX
         _bypassFramerate = false;
         _bypassStretch = false;
         _bypassSplatter = false;
+
+        _controlKernel = GetControlKernel(controlAll);
     }
 
     float Emitter::GetLongestLife() const
@@ -2103,6 +2526,13 @@ namespace TLFX
         return _cStretch->GetOT(age, lifetime);
     }
 
+    void Emitter::GetOverTimeArrays( std::vector<const EmitterArray*>& arrays ) const
+    {
+        const EmitterArray* overTime[] = { _cAlpha, _cR, _cG, _cB, _cScaleX, _cScaleY, _cSpin, _cVelocity, _cWeight, _cDirection,
+                                           _cDirectionVariationOT, _cFramerate, _cStretch };
+        arrays.assign(overTime, overTime + sizeof(overTime) / sizeof(overTime[0]));
+    }
+
     float Emitter::GetEmitterGlobalVelocity( float frame )
     {
         return _cGlobalVelocity->Get(frame);
@@ -136,6 +136,7 @@
 #include "TLFXEntity.h"
 #include "TLFXAttributeNode.h"
 #include "TLFXEmitterArray.h"
+#include "TLFXAttributeCache.h"
 
 #include <list>
 #include <vector>
@@ -149,6 +150,7 @@ namespace TLFX
     class EmitterArray;
     class Particle;
     class ParticleManager;
+    class CurvePool;
 
     class Emitter : public Entity
     {
@@ -805,9 +807,40 @@ namespace TLFX
         /**
          * Control a particle
          * Any particle spawned by an emitter is controlled by it. When a particle is updated it calls this method to find out how it should behave.
+         * The emitter controls most of its particles in batches instead, see #UpdateParticles.
          */
         void ControlParticle(Particle *particle);
 
+        /**
+         * Control many particles at once
+         * Same as calling #ControlParticle for every particle, but the over time attributes of up to #controlBatchSize particles are looked
+         * up together per attribute, see EmitterArray::EvaluateOT. Runs the control kernel specialized for the bypassers of the emitter.
+         */
+        void ControlParticles(Particle **particles, int count);
+
+        /**
+         * Control the particles with the kernel that has every feature, whatever the bypassers, instead of the specialized one
+         * For benchmarks comparing the kernels, see #ControlParticles. #AnalyseEmitter picks the specialized kernel again. The kernel is
+         * also the generic one when the emitter bypasses no feature.
+         */
+        void SetGenericControl(bool generic);
+        bool IsGenericControl() const;
+
+        /**
+         * Update all particles of the emitter on the calling thread
+         * Used by #Update instead of #UpdateChildren. Particles are moved in list order, then the ones without sub effects are controlled
+         * together with #ControlParticles. Particles with sub effects are updated and controlled one by one, see Particle::Update.
+         */
+        void UpdateParticles();
+
+        /**
+         * Update all particles of the emitter in parallel
+         * Used by #Update instead of #UpdateParticles once the emitter has more particles than ParticleManager::GetParallelUpdateThreshold.
+         * Particles are moved and controlled in parallel chunks, while releasing dead particles, updating the parent bounds and particles with
+         * sub effects (which spawn new particles) stay serial and in order.
+         */
+        void UpdateParticlesParallel(ParticleManager *pm);
+
         /**
          * Draws the current image frame
          * Draws on screen the current frame of the image the emitter uses to create particles with. Mainly just a Timeline Particles Editor method.
@@ -822,9 +855,31 @@ namespace TLFX
         void CompileAll();
         void CompileQuick();
 
+        /**
+         * Hand the attribute arrays to the pool so identical curves are shared, see EffectsLibrary::ShareCurves
+         * The pool takes ownership of the arrays, they must not be changed afterwards. Compiling the emitter again first gives it its
+         * own copy of every pooled array, the other emitters sharing them keep the pooled ones.
+         */
+        void ShareArrays(CurvePool& pool);
+
         void AnalyseEmitter();
         void ResetBypassers();
 
+        /**
+         * Bake the alpha and color curves into one table of packed RGBA values
+         * <p>The table has #colorTableSize entries over the normalized age of the particle, each holding red, green, blue and alpha as
+         * bytes (red in the lowest byte). #ControlParticle then gets the four channels with a single lookup instead of interpolating four
+         * curves. Only done for emitters whose color changes over time and repeats as often as alpha, others keep using the curves.</p>
+         * <p>Called by #CompileAll when compiling quantized, see EffectsLibrary::SetCompileQuantized.</p>
+         */
+        void BakeColorTable();
+        bool IsColorTableBaked() const;
+
+        /**
+         * Get the packed RGBA value of the color table at the age of a particle, see #BakeColorTable
+         */
+        unsigned int GetPackedColor(float age, float lifetime) const;
+
         float GetLongestLife() const;
 
         // base
@@ -860,6 +915,13 @@ namespace TLFX
         float GetEmitterDirectionVariationOT(float age, float lifetime = 0) const;
         float GetEmitterFramerate(float age, float lifetime = 0) const;
         float GetEmitterStretch(float age, float lifetime = 0) const;
+
+        /**
+         * Get the arrays of the over time attributes above, in the same order
+         * These are the curves looked up for every particle each update, for tools and benchmarks that want to look at them.
+         */
+        void GetOverTimeArrays(std::vector<const EmitterArray*>& arrays) const;
+
         // global adjusters
         float GetEmitterGlobalVelocity(float frame);
 
@@ -938,6 +1000,23 @@ namespace TLFX
         EmitterArray*                           _cStretch;              /// amount the particle is stretched by the speed it's traveling
         EmitterArray*                           _cSplatter;             /// this will randomize the distance where the particle spawns to it's point.
         bool                                    _arrayOwner;            /// only the effects/emitters in EffectsLibrary should be the owners, not the copies
+        void UnshareArrays();                                           /// copy pooled arrays before compiling them, see ShareArrays
+
+        enum { colorTableSize = 256 };
+        std::vector<unsigned int>               _colorTable;            /// packed RGBA over the particle life, see BakeColorTable
+        const unsigned int*                     _packedColor;           /// _colorTable of the library emitter, NULL if not baked
+
+        /// attributes looked up by UpdateSpawns, in the order of the cache, see GetSpawnAttributes
+        enum SpawnAttribute
+        {
+            attrAmount, attrAmountVariation, attrLife, attrLifeVariation, attrBaseWeight, attrWeightVariation, attrBaseSpeed,
+            attrVelVariation, attrBaseSpin, attrSpinVariation, attrDirectionVariation, attrEmissionRange, attrEmissionAngle,
+            attrSizeX, attrSizeY, attrSizeXVariation, attrSizeYVariation,
+            spawnAttributeCount
+        };
+        AttributeCache                          _attributeCache;        /// spawn attributes at recent frames for all copies of this library emitter
+        AttributeCache*                         _sharedAttributeCache;  /// _attributeCache of the library emitter, NULL when not compiled
+        void GetSpawnAttributes(float frame, float* values) const;
 
         // Bypassers
         bool                                    _bypassWeight;
@@ -955,6 +1034,20 @@ namespace TLFX
         bool                                    _bypassStretch;
         bool                                    _bypassSplatter;
 
+        /// bypassers the particle control is specialized for, a kernel leaves out the code of every feature it doesn't have
+        enum ControlFeature
+        {
+            controlWeight    = 1 << 0,
+            controlSpeed     = 1 << 1,
+            controlSpin      = 1 << 2,
+            controlColor     = 1 << 3,
+            controlScaleX    = 1 << 4,
+            controlFramerate = 1 << 5,
+            controlAll       = (1 << 6) - 1
+        };
+        typedef void (Emitter::*ControlKernel)(Particle **particles, int count);
+        ControlKernel                           _controlKernel;         /// ControlParticlesFor<GetControlFeatures()>, see ControlParticles
+
         // Bounding Box Info
         float                                   _AABB_ParticleMaxWidth;
         float                                   _AABB_ParticleMaxHeight;
@@ -976,6 +1069,32 @@ namespace TLFX
         float                                   _currentSizeXVariation;
         float                                   _currentSizeYVariation;
         float                                   _currentFramerate;
+
+        /// over time attributes of a batch of particles, see ControlParticles
+        enum { controlBatchSize = 64 };
+        struct ControlBatch
+        {
+            float age[controlBatchSize], lifetime[controlBatchSize];
+            float alpha[controlBatchSize], red[controlBatchSize], green[controlBatchSize], blue[controlBatchSize];
+            float spin[controlBatchSize], direction[controlBatchSize], directionVariation[controlBatchSize];
+            float scaleX[controlBatchSize], scaleY[controlBatchSize], framerate[controlBatchSize];
+            float velocity[controlBatchSize], stretch[controlBatchSize], weight[controlBatchSize];
+            float globalVelocity;
+        };
+
+        /**
+         * Particle control kernels, one per combination of #ControlFeature
+         * Features not in the mask are bypassed, so their branches are left out at compile time. #AnalyseEmitter picks the kernel
+         * matching the bypassers of the emitter, #ResetBypassers the one with all features.
+         */
+        template<unsigned int features> void ControlParticlesFor(Particle **particles, int count);
+        template<unsigned int features> void ControlParticleFor(Particle *e, const ControlBatch& batch, int i);
+        template<unsigned int count> struct ControlKernelTable;
+        static ControlKernel GetControlKernel(unsigned int features);
+        unsigned int GetControlFeatures() const;
+
+        unsigned int                            _randomSeed;            /// seeds the random sequence of every spawned particle
+        std::vector<Particle*>                  _parallelParticles;     /// scratch list for UpdateParticles and UpdateParticlesParallel
     };
 
 } // namespace TLFX
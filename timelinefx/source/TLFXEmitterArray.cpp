@@ -9,8 +9,17 @@ namespace TLFX
 {
 
     EmitterArray::EmitterArray(float min, float max)
-        : _life(0)
+        : _lastFrame(0)
+        , _shape(ShapeSampled)
+        , _storage(StorageFloat)
+        , _packedOffset(0)
+        , _packedScale(0)
+        , _lifeFrames(0)
+        , _life(0)
+        , _invLookupFrequencyOverTime(EffectsLibrary::GetInvLookupFrequencyOverTime())
         , _compiled(false)
+        , _nodesReleased(false)
+        , _pooled(false)
         , _min(min)
         , _max(max)
     {
@@ -19,12 +28,18 @@ namespace TLFX
 
     unsigned int EmitterArray::GetLastFrame() const
     {
-        return _changes.size() - 1;
+        return _lastFrame;
     }
 
     float EmitterArray::GetCompiled( unsigned int frame ) const
     {
-        unsigned int lastFrame = GetLastFrame();
+        if (_storage != StorageFloat)
+            return LookupPacked((float)frame);
+
+        if (!_frames.empty())
+            return Lookup((float)frame);
+
+        unsigned int lastFrame = _changes.size() - 1;
         if (frame <= lastFrame)
         {
             return _changes[frame];
@@ -37,23 +52,273 @@ namespace TLFX
 
     void EmitterArray::SetCompiled( unsigned int frame, float value )
     {
-        assert(frame >= 0 && frame < _changes.size());
-        if (frame >= 0 && frame < _changes.size())
-            _changes[frame] = value;
+        if (!CheckWritable("SetCompiled"))
+            return;
+
+        SetStorage(StorageFloat);
+
+        if (_frames.empty())
+        {
+            assert(frame >= 0 && frame < _changes.size());
+            if (frame >= 0 && frame < _changes.size())
+                _changes[frame] = value;
+            return;
+        }
+
+        // only compiled points can be changed in a reduced table
+        auto it = std::lower_bound(_frames.begin(), _frames.end(), (float)frame);
+        assert(it != _frames.end() && *it == (float)frame);
+        if (it != _frames.end() && *it == (float)frame)
+        {
+            size_t i = it - _frames.begin();
+            _changes[i] = value;
+            if (i > 0)
+                _slopes[i - 1] = (_changes[i] - _changes[i - 1]) / (_frames[i] - _frames[i - 1]);
+            if (i + 1 < _frames.size())
+                _slopes[i] = (_changes[i + 1] - _changes[i]) / (_frames[i + 1] - _frames[i]);
+        }
     }
 
     float& EmitterArray::operator[]( unsigned int index )
     {
+        assert(!_pooled);
+        assert(_storage == StorageFloat);
         assert(index >= 0 && index < _changes.size());
         return _changes[index];
     }
 
     const float& EmitterArray::operator[]( unsigned int index ) const
     {
+        assert(_storage == StorageFloat);
         assert(index >= 0 && index < _changes.size());
         return _changes[index];
     }
 
+    unsigned int EmitterArray::GetCompiledCount() const
+    {
+        switch (_storage)
+        {
+        case StorageByte:
+            return _packedBytes.size();
+        case StorageShort:
+            return _packedShorts.size();
+        default:
+            return _changes.size();
+        }
+    }
+
+    size_t EmitterArray::GetCompiledBytes() const
+    {
+        return (_changes.capacity() + _frames.capacity() + _slopes.capacity()) * sizeof(float)
+            + _packedBytes.capacity() + (_packedShorts.capacity() + _packedFrames.capacity()) * sizeof(unsigned short);
+    }
+
+    EmitterArray::Shape EmitterArray::GetShape() const
+    {
+        return _shape;
+    }
+
+    bool EmitterArray::IsConstant() const
+    {
+        return _shape == ShapeConstant;
+    }
+
+    void EmitterArray::SetStorage( Storage storage )
+    {
+        if (storage == _storage)
+            return;
+
+        if (!CheckWritable("SetStorage"))
+            return;
+
+        if (_storage != StorageFloat)
+        {
+            // back to floats, from the quantized values
+            std::vector<float> values(GetCompiledCount());
+            for (size_t i = 0; i < values.size(); ++i)
+                values[i] = GetPacked(i);
+
+            std::vector<float> frames(_packedFrames.begin(), _packedFrames.end());
+            std::vector<float> slopes(frames.empty() ? 0 : frames.size() - 1);
+            for (size_t i = 0; i < slopes.size(); ++i)
+                slopes[i] = (values[i + 1] - values[i]) / (frames[i + 1] - frames[i]);
+
+            _changes.swap(values);
+            _frames.swap(frames);
+            _slopes.swap(slopes);
+            std::vector<unsigned char>().swap(_packedBytes);
+            std::vector<unsigned short>().swap(_packedShorts);
+            std::vector<unsigned short>().swap(_packedFrames);
+            _storage = StorageFloat;
+        }
+
+        if (storage == StorageFloat || !_compiled || _shape == ShapeConstant || _shape == ShapeLinear || _lastFrame > 0xffff)
+            return;
+
+        float lo = _changes[0], hi = _changes[0];
+        for (auto it = _changes.begin(); it != _changes.end(); ++it)
+        {
+            lo = std::min(lo, *it);
+            hi = std::max(hi, *it);
+        }
+
+        float levels = storage == StorageByte ? 255.0f : 65535.0f;
+        _packedOffset = lo;
+        _packedScale = (hi - lo) / levels;
+        float invScale = hi > lo ? levels / (hi - lo) : 0;
+
+        for (auto it = _changes.begin(); it != _changes.end(); ++it)
+        {
+            float packed = floorf((*it - lo) * invScale + 0.5f);
+            if (storage == StorageByte)
+                _packedBytes.push_back((unsigned char)packed);
+            else
+                _packedShorts.push_back((unsigned short)packed);
+        }
+        for (auto it = _frames.begin(); it != _frames.end(); ++it)
+        {
+            _packedFrames.push_back((unsigned short)*it);
+        }
+
+        std::vector<float>().swap(_changes);
+        std::vector<float>().swap(_frames);
+        std::vector<float>().swap(_slopes);
+        _storage = storage;
+    }
+
+    EmitterArray::Storage EmitterArray::GetStorage() const
+    {
+        return _storage;
+    }
+
+    size_t EmitterArray::GetMemoryBytes() const
+    {
+        return sizeof(EmitterArray) + _attributes.capacity() * sizeof(AttributeNode) + _segments.capacity() * sizeof(Segment) + GetCompiledBytes();
+    }
+
+    namespace
+    {
+        // FNV-1a
+        inline void HashBytes(size_t& hash, const void* data, size_t size)
+        {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < size; ++i)
+            {
+                hash ^= bytes[i];
+                hash *= 16777619u;
+            }
+        }
+
+        inline void HashFloat(size_t& hash, float value)
+        {
+            if (value == 0)
+                value = 0;                          // -0 and 0 are the same curve
+            HashBytes(hash, &value, sizeof(value));
+        }
+    }
+
+    size_t EmitterArray::GetHash() const
+    {
+        size_t hash = 2166136261u;
+        HashFloat(hash, _min);
+        HashFloat(hash, _max);
+        HashFloat(hash, (float)_life);
+        HashFloat(hash, _invLookupFrequencyOverTime);
+        HashFloat(hash, (float)_lastFrame);
+        HashFloat(hash, _compiled ? 1.0f : 0);
+        for (auto it = _attributes.begin(); it != _attributes.end(); ++it)
+        {
+            HashFloat(hash, it->frame);
+            HashFloat(hash, it->value);
+            if (it->isCurve)
+            {
+                HashFloat(hash, it->c0x);
+                HashFloat(hash, it->c0y);
+                HashFloat(hash, it->c1x);
+                HashFloat(hash, it->c1y);
+            }
+        }
+        return hash;
+    }
+
+    bool EmitterArray::IsSameCurve( const EmitterArray& other ) const
+    {
+        if (_min != other._min || _max != other._max || _life != other._life || _invLookupFrequencyOverTime != other._invLookupFrequencyOverTime
+            || _lastFrame != other._lastFrame || _compiled != other._compiled || _shape != other._shape)
+            return false;
+
+        if (_attributes.size() != other._attributes.size())
+            return false;
+
+        for (auto it = _attributes.begin(), it2 = other._attributes.begin(); it != _attributes.end(); ++it, ++it2)
+        {
+            if (it->frame != it2->frame || it->value != it2->value || it->isCurve != it2->isCurve)
+                return false;
+            if (it->isCurve && (it->c0x != it2->c0x || it->c0y != it2->c0y || it->c1x != it2->c1x || it->c1y != it2->c1y))
+                return false;
+        }
+
+        // the tables follow from the above, unless one was changed with SetCompiled
+        return _changes == other._changes && _frames == other._frames && _storage == other._storage && _packedBytes == other._packedBytes
+            && _packedShorts == other._packedShorts && _packedFrames == other._packedFrames;
+    }
+
+    void EmitterArray::ReleaseNodes()
+    {
+        // without a table there would be nothing left to look up
+        assert(_compiled);
+        if (!_compiled)
+            return;
+
+        std::vector<AttributeNode>().swap(_attributes);
+        std::vector<Segment>().swap(_segments);
+        _nodesReleased = true;
+    }
+
+    bool EmitterArray::IsCompiled() const
+    {
+        return _compiled;
+    }
+
+    bool EmitterArray::IsNodesReleased() const
+    {
+        return _nodesReleased;
+    }
+
+    void EmitterArray::SetPooled( bool pooled )
+    {
+        _pooled = pooled;
+    }
+
+    bool EmitterArray::IsPooled() const
+    {
+        return _pooled;
+    }
+
+    bool EmitterArray::CheckNodes( const char* call ) const
+    {
+        (void)call;                                 // only logged
+        if (_nodesReleased)
+        {
+            TLFXLOG(EFFECTS, ("EmitterArray::%s: the attribute nodes were released after compiling, see EffectsLibrary::SetRuntimeOnly", call));
+            assert(!"attribute nodes were released, the curve can't be compiled, interpolated or edited");
+            return false;
+        }
+        return true;
+    }
+
+    bool EmitterArray::CheckWritable( const char* call ) const
+    {
+        (void)call;                                 // only logged
+        if (_pooled)
+        {
+            TLFXLOG(EFFECTS, ("EmitterArray::%s: the curve is shared through a CurvePool, copy it before changing it", call));
+            assert(!"pooled curves are shared by several effects and emitters and can't be compiled or edited");
+            return false;
+        }
+        return true;
+    }
+
     int EmitterArray::GetLife() const
     {
         return _life;
@@ -61,103 +326,277 @@ namespace TLFX
 
     void EmitterArray::SetLife( int life )
     {
+        if (!CheckWritable("SetLife"))
+            return;
+
         _life = life;
+        _lifeFrames = _life * _invLookupFrequencyOverTime;
     }
 
     void EmitterArray::Compile()
     {
+        if (!CheckNodes("Compile") || !CheckWritable("Compile"))
+            return;
+
+        std::vector<float> samples;
         if (_attributes.size() > 0)
         {
+            BuildSegments();
+
             const AttributeNode* lastec = &_attributes.back();
             float lookupFrequency = EffectsLibrary::GetLookupFrequency();
             int frame = (int)ceilf(lastec->frame / lookupFrequency);
-            /*
-            while (age < lastec->frame)
-            {
-                ++frame;
-                age += lookupFrequency;
-            }
-            */
-            _changes.resize(frame+1);
+            samples.reserve(frame+1);
             frame = 0;
             float age = 0;
+            Cursor cursor;
             while (age < lastec->frame)
             {
-                SetCompiled(frame, Interpolate(age));
+                samples.push_back(InterpolateOT(age, 1.0f, cursor));
                 ++frame;
                 age = frame * lookupFrequency;
             }
-            SetCompiled(frame, lastec->value);
+            samples.push_back(lastec->value);
         }
         else
         {
-            _changes.resize(1);
+            samples.push_back(0);
         }
+        Bake(samples);
         _compiled = true;
     }
 
     void EmitterArray::CompileOT(float longestLife)
     {
+        if (!CheckNodes("CompileOT") || !CheckWritable("CompileOT"))
+            return;
+
+        std::vector<float> samples;
         if (_attributes.size() > 0)
         {
+            BuildSegments();
+
             const AttributeNode* lastec = &_attributes.back();
             float lookupFrequency = EffectsLibrary::GetLookupFrequencyOverTime();
+            _invLookupFrequencyOverTime = EffectsLibrary::GetInvLookupFrequencyOverTime();
             int frame = (int)ceilf(longestLife / lookupFrequency);
-            /*
-            while (age < longestLife)
-            {
-                ++frame;
-                age += lookupFrequency;
-            }
-            */
-            _changes.resize(frame+1);
+            samples.reserve(frame+1);
             frame = 0;
             float age = 0;
+            Cursor cursor;
             while (age < longestLife)
             {
-                SetCompiled(frame, InterpolateOT(age, longestLife));
+                samples.push_back(InterpolateOT(age, longestLife, cursor));
                 ++frame;
                 age = frame * lookupFrequency;
             }
-            SetCompiled(frame, lastec->value);
+            samples.push_back(lastec->value);
             SetLife((int)longestLife);
         }
         else
         {
-            _changes.resize(1);
+            samples.push_back(0);
         }
+        Bake(samples);
         _compiled = true;
     }
 
+    void EmitterArray::Bake( const std::vector<float>& samples )
+    {
+        _lastFrame = samples.size() - 1;
+        _storage = StorageFloat;
+        std::vector<unsigned char>().swap(_packedBytes);
+        std::vector<unsigned short>().swap(_packedShorts);
+        std::vector<unsigned short>().swap(_packedFrames);
+
+        if (EffectsLibrary::GetCompileTolerance() <= 0 || samples.size() <= 2)
+        {
+            // a point for every frame
+            std::vector<float>(samples).swap(_changes);
+            std::vector<float>().swap(_frames);
+            std::vector<float>().swap(_slopes);
+            _shape = _changes.size() == 1 ? ShapeConstant : ShapeSampled;
+            return;
+        }
+
+        float lo = samples[0], hi = samples[0];
+        for (auto it = samples.begin(); it != samples.end(); ++it)
+        {
+            lo = std::min(lo, *it);
+            hi = std::max(hi, *it);
+        }
+        float tolerance = EffectsLibrary::GetCompileTolerance() * (hi - lo);
+
+        std::vector<float> frames, values;
+        frames.push_back(0);
+        values.push_back(samples[0]);
+
+        if (hi > lo)
+        {
+            // Grow each segment for as long as a line from its start can pass within tolerance of every sample, keeping the window
+            // of slopes that still do. When the window closes the segment ends at the previous sample and the next one starts there.
+            float startFrame = 0, startValue = samples[0];
+            float minSlope = -HUGE_VALF, maxSlope = HUGE_VALF;
+            unsigned int last = samples.size() - 1;
+            for (unsigned int i = 1; i <= last; ++i)
+            {
+                float dx = i - startFrame;
+                float low = std::max(minSlope, (samples[i] - tolerance - startValue) / dx);
+                float high = std::min(maxSlope, (samples[i] + tolerance - startValue) / dx);
+                if (low > high)
+                {
+                    float end = (float)(i - 1);
+                    float slope = std::min(maxSlope, std::max(minSlope, (samples[i - 1] - startValue) / (end - startFrame)));
+                    startValue += slope * (end - startFrame);
+                    startFrame = end;
+                    frames.push_back(startFrame);
+                    values.push_back(startValue);
+
+                    low = samples[i] - tolerance - startValue;
+                    high = samples[i] + tolerance - startValue;
+                }
+                minSlope = low;
+                maxSlope = high;
+            }
+            float slope = std::min(maxSlope, std::max(minSlope, (samples[last] - startValue) / (last - startFrame)));
+            frames.push_back((float)last);
+            values.push_back(startValue + slope * (last - startFrame));
+        }
+
+        std::vector<float> slopes(frames.size() - 1);
+        for (size_t i = 0; i + 1 < frames.size(); ++i)
+        {
+            slopes[i] = (values[i + 1] - values[i]) / (frames[i + 1] - frames[i]);
+        }
+
+        _changes.swap(values);
+        _frames.swap(frames);
+        _slopes.swap(slopes);
+
+        if (_frames.size() == 1)
+            _shape = ShapeConstant;
+        else if (_frames.size() == 2)
+            _shape = ShapeLinear;
+        else
+            _shape = ShapePiecewiseLinear;
+    }
+
+    float EmitterArray::Lookup( float frame ) const
+    {
+        if (frame <= _frames.front())
+            return _changes.front();
+        if (frame >= _frames.back())
+            return _changes.back();
+
+        size_t i = 0;
+        if (_shape != ShapeLinear)
+            i = std::upper_bound(_frames.begin(), _frames.end(), frame) - _frames.begin() - 1;
+        return _changes[i] + (frame - _frames[i]) * _slopes[i];
+    }
+
+    float EmitterArray::GetPacked( unsigned int index ) const
+    {
+        return _packedOffset + (_storage == StorageByte ? _packedBytes[index] : _packedShorts[index]) * _packedScale;
+    }
+
+    float EmitterArray::LookupPacked( float frame ) const
+    {
+        unsigned int last = GetCompiledCount() - 1;
+        if (_packedFrames.empty())
+        {
+            // a value for every frame
+            return GetPacked(frame > 0 ? std::min((unsigned int)frame, last) : 0);
+        }
+
+        if (frame <= _packedFrames.front())
+            return GetPacked(0);
+        if (frame >= _packedFrames.back())
+            return GetPacked(last);
+
+        size_t i = std::upper_bound(_packedFrames.begin(), _packedFrames.end(), frame) - _packedFrames.begin() - 1;
+        float f0 = _packedFrames[i], v0 = GetPacked(i);
+        return v0 + (frame - f0) * (GetPacked(i + 1) - v0) / (_packedFrames[i + 1] - f0);
+    }
+
     void EmitterArray::CompileOT()
     {
+        if (!CheckNodes("CompileOT") || !CheckWritable("CompileOT"))
+            return;
+
         CompileOT(_attributes.back().frame);
     }
 
     void EmitterArray::Sort()
     {
-        _attributes.sort();
-        //std::sort_heap(_attributes.begin(), _attributes.end());
+        if (!CheckNodes("Sort") || !CheckWritable("Sort"))
+            return;
+
+        std::stable_sort(_attributes.begin(), _attributes.end());
+        BuildSegments();
         _compiled = false;
+        _shape = ShapeSampled;
     }
 
     AttributeNode* EmitterArray::Add( float frame, float value )
     {
+        if (!CheckNodes("Add") || !CheckWritable("Add"))
+            return NULL;
+
         _compiled = false;
+        _shape = ShapeSampled;
 
         AttributeNode e;
         e.frame = frame;
         e.value = value;
         _attributes.push_back(e);
+        _segments.clear();
         return &(_attributes.back());
     }
 
     void EmitterArray::Clear(unsigned int size /*= 0*/)
     {
+        if (!CheckNodes("Clear") || !CheckWritable("Clear"))
+            return;
+
         _attributes.resize(size);
+        _segments.clear();
         _compiled = true;
     }
 
+    void EmitterArray::BuildSegments()
+    {
+        _segments.resize(_attributes.size());
+        for (size_t i = 0; i < _attributes.size(); ++i)
+        {
+            Segment& s = _segments[i];
+            s.a = s.b = s.c = s.d = 0;
+            s.curved = false;
+            if (i == 0)
+                continue;
+
+            // same control points as GetBezierValue, in power form
+            const AttributeNode& lastec = _attributes[i - 1];
+            const AttributeNode& a = _attributes[i];
+            if (a.isCurve && lastec.isCurve)
+            {
+                float p0 = lastec.value, p1 = lastec.c1y, p2 = a.c0y, p3 = a.value;
+                s.a = p3 - p0 + 3 * (p1 - p2);
+                s.b = 3 * (p0 - 2 * p1 + p2);
+                s.c = 3 * (p1 - p0);
+                s.d = p0;
+                s.curved = true;
+            }
+            else if (a.isCurve || lastec.isCurve)
+            {
+                float p0 = lastec.value, p1 = a.isCurve ? a.c0y : lastec.c1y, p2 = a.value;
+                s.b = p0 - 2 * p1 + p2;
+                s.c = 2 * (p1 - p0);
+                s.d = p0;
+                s.curved = true;
+            }
+        }
+    }
+
     float EmitterArray::GetBezierValue( const AttributeNode& lastec, const AttributeNode& a, float t, float yMin, float yMax )
     {
         if (a.isCurve)
@@ -237,37 +676,88 @@ namespace TLFX
 
     float EmitterArray::InterpolateOT( float age, float lifetime, bool bezier /*= true*/ ) const
     {
+        if (!CheckNodes("InterpolateOT"))
+            return 0;
+
+        return InterpolateNode(FindNode(age, lifetime, NULL), age, lifetime, bezier);
+    }
+
+    float EmitterArray::InterpolateOT( float age, float lifetime, Cursor& cursor, bool bezier /*= true*/ ) const
+    {
+        if (!CheckNodes("InterpolateOT"))
+            return 0;
+
+        return InterpolateNode(FindNode(age, lifetime, &cursor), age, lifetime, bezier);
+    }
+
+    unsigned int EmitterArray::FindNode( float age, float lifetime, Cursor* cursor ) const
+    {
+        // first node after age
+        unsigned int count = _attributes.size();
+        unsigned int node;
+        if (cursor && cursor->index <= count && (cursor->index == 0 || !(age < _attributes[cursor->index - 1].frame * lifetime)))
+        {
+            // age didn't go back, walk on from the last node
+            node = cursor->index;
+            while (node < count && !(age < _attributes[node].frame * lifetime))
+                ++node;
+        }
+        else
+        {
+            node = std::upper_bound(_attributes.begin(), _attributes.end(), age,
+                [lifetime](float age, const AttributeNode& a) { return age < a.frame * lifetime; }) - _attributes.begin();
+        }
+
+        if (cursor)
+            cursor->index = node;
+        return node;
+    }
+
+    float EmitterArray::InterpolateNode( unsigned int node, float age, float lifetime, bool bezier ) const
+    {
+        if (node >= _attributes.size())
+            return _attributes.empty() ? 0 : _attributes.back().value;
+
+        const AttributeNode& a = _attributes[node];
         float lasty = 0;
         float lastf = 0;
-        const AttributeNode* lastec = NULL;
+        if (node > 0)
+        {
+            lasty = _attributes[node - 1].value;
+            lastf = _attributes[node - 1].frame * lifetime;
+        }
 
-        for (auto it = _attributes.begin(); it != _attributes.end(); ++it)
+        float p = float(age - lastf) / (a.frame * lifetime - lastf);
+        if (bezier && node > 0)
         {
-            float frame = it->frame * lifetime;
-            if (age < frame)
+            float bezierValue = 0;
+            if (_segments.size() == _attributes.size())
             {
-                float p = float(age - lastf) / (frame - lastf);
-                if (bezier)
-                {
-                    float bezierValue = GetBezierValue(*lastec, *it, p, _min, _max);
-                    if (bezierValue != 0)
-                    {
-                        return bezierValue;
-                    }
-                }
-                return lasty - p * (lasty - it->value);
+                const Segment& s = _segments[node];
+                if (s.curved)
+                    bezierValue = std::min(std::max(((s.a * p + s.b) * p + s.c) * p + s.d, _min), _max);
+            }
+            else
+            {
+                bezierValue = GetBezierValue(_attributes[node - 1], a, p, _min, _max);
+            }
+
+            if (bezierValue != 0)
+            {
+                return bezierValue;
             }
-            lasty = it->value;
-            lastf = frame/* - 1*/;
-            if (bezier) lastec = &(*it);
         }
-        return lasty;
+        return lasty - p * (lasty - a.value);
     }
 
     float EmitterArray::Get( float frame, bool bezier /*= true*/ ) const
     {
         if (_compiled)
-            return GetCompiled((unsigned int)frame);
+        {
+            if (_storage != StorageFloat)
+                return LookupPacked(frame);
+            return _frames.empty() ? GetCompiled((unsigned int)frame) : Lookup(frame);
+        }
         else
             return Interpolate(frame, bezier);
     }
@@ -279,11 +769,18 @@ namespace TLFX
 
     float EmitterArray::GetOT( float age, float lifetime, bool bezier /*= true*/ ) const
     {
+        if (_shape == ShapeConstant)
+            return _changes[0];
+
         float frame = 0;
         if (lifetime > 0)
         {
-            frame = age / lifetime * _life / EffectsLibrary::GetLookupFrequencyOverTime();
+            frame = age / lifetime * _lifeFrames;
         }
+
+        if (_shape == ShapeLinear)
+            return frame < _frames[1] ? _changes[0] + frame * _slopes[0] : _changes[1];
+
         return Get(frame);
     }
 
@@ -292,13 +789,52 @@ namespace TLFX
         return GetOT(age, lifetime);
     }
 
+    void EmitterArray::EvaluateOT( const float* ages, const float* lifetimes, float* out, size_t n ) const
+    {
+        if (_shape == ShapeConstant)
+        {
+            std::fill(out, out + n, _changes[0]);
+            return;
+        }
+
+        // lookup frames of the whole batch first
+        for (size_t i = 0; i < n; ++i)
+            out[i] = lifetimes[i] > 0 ? ages[i] / lifetimes[i] * _lifeFrames : 0;
+
+        if (_shape == ShapeLinear)
+        {
+            float start = _changes[0], end = _changes[1], slope = _slopes[0], endFrame = _frames[1];
+            for (size_t i = 0; i < n; ++i)
+                out[i] = out[i] < endFrame ? start + out[i] * slope : end;
+        }
+        else if (_compiled && _storage == StorageFloat && _frames.empty())
+        {
+            // a value for every frame, just a gather
+            const float* table = &_changes[0];
+            unsigned int last = _changes.size() - 1;
+            for (size_t i = 0; i < n; ++i)
+                out[i] = table[std::min((unsigned int)out[i], last)];
+        }
+        else
+        {
+            for (size_t i = 0; i < n; ++i)
+                out[i] = Get(out[i]);
+        }
+    }
+
     unsigned int EmitterArray::GetAttributesCount() const
     {
+        if (!CheckNodes("GetAttributesCount"))
+            return 0;
+
         return _attributes.size();
     }
 
     float EmitterArray::GetMaxValue() const
     {
+        if (!CheckNodes("GetMaxValue"))
+            return 0;
+
         float max = 0;
         for (auto it = _attributes.begin(); it != _attributes.end(); ++it)
         {
@@ -8,7 +8,7 @@
 #include "TLFXAttributeNode.h"
 
 #include <vector>
-#include <list>
+#include <cstddef>
 
 namespace TLFX
 {
@@ -16,6 +16,37 @@ namespace TLFX
     class EmitterArray
     {
     public:
+        /**
+         * What the compiled table of the attribute looks like, lookups take a shortcut for the simpler shapes
+         */
+        enum Shape
+        {
+            ShapeConstant,                  // a single value
+            ShapeLinear,                    // a straight line from the first to the last frame
+            ShapePiecewiseLinear,           // reduced table, see #Compile
+            ShapeSampled                    // a value for every lookup frame, or not compiled
+        };
+
+        /**
+         * How the values of a compiled table are stored, see #SetStorage
+         */
+        enum Storage
+        {
+            StorageFloat,
+            StorageByte,                    // 8 bit, enough for color and alpha
+            StorageShort                    // 16 bit fixed point
+        };
+
+        /**
+         * Position in the attribute nodes kept between calls of #InterpolateOT
+         * Ages that only go up, as when sampling a curve from start to end, then find their node without a search.
+         */
+        struct Cursor
+        {
+            Cursor() : index(0) {}
+            unsigned int index;
+        };
+
         EmitterArray(float min, float max);
 
         void           Clear(unsigned int size = 0);
@@ -25,9 +56,20 @@ namespace TLFX
         float          GetOT(float age, float lifetime, bool bezier = true) const;
         float          operator()(float age, float lifetime, bool bezier = true) const;
 
+        /**
+         * Get the over time values of many particles at once, out[i] is the same as GetOT(ages[i], lifetimes[i])
+         * The lookup frames are worked out for the whole batch before any table is read, both loops are simple enough to vectorize.
+         */
+        void           EvaluateOT(const float* ages, const float* lifetimes, float* out, size_t n) const;
+
         float          Interpolate(float frame, bool bezier = true) const;
         float          InterpolateOT(float age, float lifetime, bool bezier = true) const;
+        float          InterpolateOT(float age, float lifetime, Cursor& cursor, bool bezier = true) const;
 
+        /**
+         * Sort the attribute nodes by frame and work out the curves between them
+         * Call this after changing nodes through the pointer #Add returns, until then curves are worked out on every interpolation.
+         */
         void           Sort();
 
         unsigned int   GetAttributesCount() const;
@@ -35,33 +77,132 @@ namespace TLFX
         float           GetMaxValue() const;
 
         // compiled
+        /**
+         * Compile the attribute into a lookup table
+         * <p>The curve is sampled once per lookup frame (see EffectsLibrary::SetLookupFrequency), then reduced to the fewest points that
+         * linear interpolation needs to stay within EffectsLibrary::GetCompileTolerance of every sample. A straight fade compiles to 2 points
+         * and a constant attribute to 1, whatever the length of the curve.</p>
+         */
         void           Compile();
         void           CompileOT(float longestLife);
         void           CompileOT();
 
+        /**
+         * Get the last lookup frame of the compiled curve, the same whether or not it was reduced
+         */
         unsigned int   GetLastFrame() const;
         float          GetCompiled(unsigned int frame) const;
         void           SetCompiled(unsigned int frame, float value);
 
-        float&         operator[](unsigned int frame);
-        const float&   operator[](unsigned int frame) const;
+        /**
+         * Access the value of a compiled point
+         * Points only match lookup frames when the table isn't reduced, see #GetCompiledCount.
+         */
+        float&         operator[](unsigned int index);
+        const float&   operator[](unsigned int index) const;
+
+        /**
+         * Get the number of compiled points and the memory they take
+         */
+        unsigned int   GetCompiledCount() const;
+        size_t         GetCompiledBytes() const;
+
+        Shape          GetShape() const;
+        bool           IsConstant() const;
+
+        /**
+         * Quantize the compiled table
+         * <p>Values are stored as 8 or 16 bit fixed point between the lowest and highest value of the table and frames as 16 bit integers,
+         * cutting the memory of a table to a quarter or half. Values are only decoded when looked up. Constant and linear tables are always
+         * kept as floats, they are only a few values and have their own shortcuts.</p>
+         * <p>Compile the array before quantizing, compiling again goes back to float storage. Tables longer than 65535 frames stay float.</p>
+         */
+        void           SetStorage(Storage storage);
+        Storage        GetStorage() const;
+
+        /**
+         * Get the memory taken by the attribute nodes and compiled table, including the array itself
+         */
+        size_t         GetMemoryBytes() const;
+
+        /**
+         * Hash and compare the attribute nodes, value range and compile parameters, see #CurvePool
+         * Curves that are the same compile to the same table and can be shared.
+         */
+        size_t         GetHash() const;
+        bool           IsSameCurve(const EmitterArray& other) const;
+
+        /**
+         * Free the attribute nodes of a compiled array, see EffectsLibrary::SetRuntimeOnly
+         * <p>Lookups keep working from the compiled table, but the curve can't be compiled, interpolated or edited any more, and
+         * #GetAttributesCount and #GetMaxValue have no nodes to look at: those calls assert and log an error in a debug build and do
+         * nothing or return 0 in a release build.</p>
+         */
+        void           ReleaseNodes();
+        bool           IsCompiled() const;
+        bool           IsNodesReleased() const;
+
+        /**
+         * Mark the array as shared through a #CurvePool
+         * <p>Pooled arrays are used by several effects and emitters, so they can't be compiled or edited any more: those calls assert
+         * and log an error in a debug build and do nothing in a release build. Copy the array to change it, see Effect::CompileAll.</p>
+         */
+        void           SetPooled(bool pooled);
+        bool           IsPooled() const;
 
         int            GetLife() const;
         void           SetLife(int life);
 
     protected:
-        std::list<AttributeNode> _attributes;
+        /**
+         * Bezier curve from the previous node to a node, as ((a * t + b) * t + c) * t + d for t from 0 to 1
+         */
+        struct Segment
+        {
+            float a, b, c, d;
+            bool  curved;                   // false when neither node is a curve, the value is interpolated linearly
+        };
+
+        std::vector<AttributeNode> _attributes;                 // sorted by frame, see Sort
+        std::vector<Segment>     _segments;                     // one per node, empty when out of date
 
         // compiled
-        std::vector<float>       _changes;
+        std::vector<float>       _changes;                      // value of every compiled point
+        std::vector<float>       _frames;                       // lookup frame of every compiled point, empty when there is one per frame
+        std::vector<float>       _slopes;                       // change per lookup frame from each compiled point to the next
+        unsigned int             _lastFrame;
+        Shape                    _shape;
+
+        // quantized, see SetStorage
+        Storage                  _storage;
+        std::vector<unsigned char>  _packedBytes;               // StorageByte values
+        std::vector<unsigned short> _packedShorts;              // StorageShort values
+        std::vector<unsigned short> _packedFrames;              // empty when there is one value per frame
+        float                    _packedOffset, _packedScale;   // value = offset + packed * scale
+
+        float                    _lifeFrames;                   // _life in lookup frames, for GetOT
         int                      _life;
+        float                    _invLookupFrequencyOverTime;  // the over time frequency the table was compiled with
         bool                     _compiled;
+        bool                     _nodesReleased;
+        bool                     _pooled;                       // shared through a CurvePool, see SetPooled
         float                    _min, _max;
 
         static float GetBezierValue(const AttributeNode& lastec, const AttributeNode& a, float t, float yMin, float yMax);
         static void GetQuadBezier(float p0x, float p0y, float p1x, float p1y, float p2x, float p2y, float t, float yMin, float yMax, float& outX, float& outY, bool clamp = true);
         static void GetCubicBezier(float p0x, float p0y, float p1x, float p1y, float p2x, float p2y, float p3x, float p3y,
             float t, float yMin, float yMax, float& outX, float& outY, bool clamp = true);
+
+        bool CheckNodes(const char* call) const;
+        bool CheckWritable(const char* call) const;
+        void BuildSegments();
+        unsigned int FindNode(float age, float lifetime, Cursor* cursor) const;
+        float InterpolateNode(unsigned int node, float age, float lifetime, bool bezier) const;
+
+        void Bake(const std::vector<float>& samples);
+        float Lookup(float frame) const;
+        float LookupPacked(float frame) const;
+        float GetPacked(unsigned int index) const;
     };
 
 } // namespace TLFX
@@ -99,6 +99,8 @@ namespace TLFX
 
         , _runChildren(false)
         , _pixelsPerSecond(0)
+
+        , _timeContext(&EffectsLibrary::GetDefaultTimeContext())
     {
 
     }
@@ -215,6 +217,8 @@ namespace TLFX
         , _runChildren(o._runChildren)
 
         , _pixelsPerSecond(o._pixelsPerSecond)
+
+        , _timeContext(o._timeContext)
     {
         // do not copy children as we don't know their type
         // Emitter and Effect should take care about this
@@ -237,12 +241,30 @@ namespace TLFX
 
     bool Entity::Update()
     {
-        float currentUpdateTime = EffectsLibrary::GetCurrentUpdateTime();
+        UpdateMotion();
+
+        // update the Axis Aligned Bounding Box
+        if (_AABB_Calculate)
+            UpdateBoundingBox();
+
+        // update the radius of influence
+        if (_radiusCalculate)
+            UpdateEntityRadius();
+
+        // update the children
+        UpdateChildren();
+
+        return true;
+    }
+
+    void Entity::UpdateMotion()
+    {
+        float invUpdateTime = _timeContext->GetInvCurrentUpdateTime();
 
         // Update speed in pixels per second
         if (_updateSpeed && _speed)
         {
-            _pixelsPerSecond = _speed / currentUpdateTime;
+            _pixelsPerSecond = _speed * invUpdateTime;
             _speedVec.x = sinf(_direction / 180.0f * (float)M_PI) * _pixelsPerSecond;
             _speedVec.y = cosf(_direction / 180.0f * (float)M_PI) * _pixelsPerSecond;
 
@@ -253,8 +275,8 @@ namespace TLFX
         // update the gravity
         if (_weight != 0)
         {
-            _gravity += _weight / currentUpdateTime;
-            _y += (_gravity / currentUpdateTime) * _z;
+            _gravity += _weight * invUpdateTime;
+            _y += (_gravity * invUpdateTime) * _z;
         }
 
         // set the matrix if it is relative to the parent
@@ -292,7 +314,7 @@ namespace TLFX
         // update animation frame
         if (_avatar && _animating)
         {
-            _currentFrame += _framerate / currentUpdateTime;
+            _currentFrame += _framerate * invUpdateTime;
             if (_animateOnce)
             {
                 if (_currentFrame > _avatar->GetFramesCount() - 1)
@@ -305,19 +327,6 @@ namespace TLFX
                 }
             }
         }
-
-        // update the Axis Aligned Bounding Box
-        if (_AABB_Calculate)
-            UpdateBoundingBox();
-
-        // update the radius of influence
-        if (_radiusCalculate)
-            UpdateEntityRadius();
-
-        // update the children
-        UpdateChildren();
-
-        return true;
     }
 
     void Entity::SetX(float x)
@@ -427,6 +436,14 @@ namespace TLFX
     }
 
     void Entity::UpdateBoundingBox()
+    {
+        UpdateLocalBoundingBox();
+
+        if (_children.empty())
+            UpdateParentBoundingBox();
+    }
+
+    void Entity::UpdateLocalBoundingBox()
     {
         if (_z != 1.0f)
         {
@@ -447,12 +464,17 @@ namespace TLFX
         _AABB_YMin = _collisionYMin;
         _AABB_XMax = _collisionXMax;
         _AABB_YMax = _collisionYMax;
-
-        if (_children.empty())
-            UpdateParentBoundingBox();
     }
 
     void Entity::UpdateEntityRadius()
+    {
+        UpdateLocalEntityRadius();
+
+        if (_rootParent)
+            UpdateRootParentEntityRadius();
+    }
+
+    void Entity::UpdateLocalEntityRadius()
     {
         if (_autoCenter)
         {
@@ -487,9 +509,6 @@ namespace TLFX
 
         _entityRadius = _imageRadius;
         _imageDiameter = _imageRadius * 2.0f;
-
-        if (_rootParent)
-            UpdateRootParentEntityRadius();
     }
 
     void Entity::UpdateParentEntityRadius()
@@ -837,6 +856,17 @@ namespace TLFX
         return _blendMode;
     }
 
+    void Entity::SetTimeContext( const TimeContext* context )
+    {
+        assert(context);
+        _timeContext = context;
+    }
+
+    const TimeContext* Entity::GetTimeContext() const
+    {
+        return _timeContext;
+    }
+
     bool Entity::IsRelative() const
     {
         return _relative;
@@ -15,6 +15,7 @@ namespace TLFX
 {
 
     class AnimImage;
+    class TimeContext;
     struct AttributeNode;
 
     /**
@@ -63,6 +64,12 @@ namespace TLFX
          */
         virtual bool Update();
 
+        /**
+         * Update the speed, gravity, matrix, world coordinates and animation frame of the entity
+         * This is the part of #Update that only changes the entity itself, it doesn't touch the parent or the children.
+         */
+        void UpdateMotion();
+
         /**
          * A mini update called when the entity is created
          * This is sometimes necessary to get the correct world coordinates for when new entities are spawned so that tweening is updated too. Otherwise
@@ -96,6 +103,11 @@ namespace TLFX
          */
         void UpdateBoundingBox();
 
+        /**
+         * Update the entities bounding box without updating the bounding box of its parent
+         */
+        void UpdateLocalBoundingBox();
+
         /**
          * Update the entity's radius of influence
          * The radius of influence is the area around the entity that could possibly be drawn to. This is used in the timelinefx editor where
@@ -103,6 +115,11 @@ namespace TLFX
          */
         void UpdateEntityRadius();
 
+        /**
+         * Update the entity's radius of influence without updating the radius of its root parent
+         */
+        void UpdateLocalEntityRadius();
+
         /**
          * Update the entity's parent radius of influence
          */
@@ -466,6 +483,18 @@ namespace TLFX
          */
         Entity* GetParent() const;
 
+        /**
+         * Set the time context used when updating the entity
+         * Entities start with EffectsLibrary::GetDefaultTimeContext, effects, emitters and particles are switched to the context
+         * of the #ParticleManager they are added to.
+         */
+        void SetTimeContext(const TimeContext* context);
+
+        /**
+         * Get the time context used when updating the entity
+         */
+        const TimeContext* GetTimeContext() const;
+
         /**
          * Get the children that this entity has
          * This will return a list of children that the entity currently has
@@ -722,6 +751,8 @@ namespace TLFX
         bool                            _runChildren;               // When the entity is created, this is false to avoid running it's children on creation to avoid recursion
         // temps
         float                           _pixelsPerSecond;
+        // timing
+        const TimeContext*              _timeContext;               // update frequency of the particle manager owning the entity
     };
 
 } // namespace TLFX
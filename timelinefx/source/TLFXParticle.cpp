@@ -4,6 +4,8 @@
 #include "TLFXEffect.h"
 #include "TLFXEffectsLibrary.h"         // TLFXLOG
 
+#include <cassert>
+
 namespace TLFX
 {
 
@@ -31,6 +33,7 @@ namespace TLFX
         , _groupParticles(false)
         , _effectLayer(0)
 		// can't initialize _listIter without knowing what list this particle will be put into
+        , _randomState(0x9e3779b9u)
     {
 
     }
@@ -40,23 +43,7 @@ namespace TLFX
         TLFXLOG(PARTICLES, ("particle #%p update", this));
 
         Capture();
-
-        if (_emitter->IsDying() || _emitter->IsOneShot() || _dead)
-            _releaseSingleParticle = true;
-
-        if (_emitter->IsSingleParticle() && !_releaseSingleParticle)
-        {
-            _age = _particleManager->GetCurrentTime() - _dob;
-            if (_age > _lifeTime)
-            {
-                _age = 0;
-                _dob = _particleManager->GetCurrentTime();
-            }
-        }
-        else
-        {
-            _age = _particleManager->GetCurrentTime() - _dob;
-        }
+        UpdateAge();
 
         base::Update();
 
@@ -85,6 +72,63 @@ namespace TLFX
         return true;
     }
 
+    void Particle::UpdateLocal()
+    {
+        assert(_children.empty());
+
+        Capture();
+        UpdateAge();
+
+        UpdateMotion();
+
+        if (_AABB_Calculate)
+            UpdateLocalBoundingBox();
+
+        if (_radiusCalculate)
+            UpdateLocalEntityRadius();
+    }
+
+    bool Particle::FinishUpdate()
+    {
+        if (_AABB_Calculate)
+            UpdateParentBoundingBox();
+
+        if (_radiusCalculate && _rootParent)
+            UpdateRootParentEntityRadius();
+
+        if (_age > _lifeTime || _dead == 2)
+        {
+            _dead = 1;
+            _particleManager->ReleaseParticle(this);
+            if (_emitter->IsGroupParticles())
+                _emitter->GetParentEffect()->RemoveInUse(_layer, this);
+
+            Reset();
+            return false;
+        }
+        return true;
+    }
+
+    void Particle::UpdateAge()
+    {
+        if (_emitter->IsDying() || _emitter->IsOneShot() || _dead)
+            _releaseSingleParticle = true;
+
+        if (_emitter->IsSingleParticle() && !_releaseSingleParticle)
+        {
+            _age = _particleManager->GetCurrentTime() - _dob;
+            if (_age > _lifeTime)
+            {
+                _age = 0;
+                _dob = _particleManager->GetCurrentTime();
+            }
+        }
+        else
+        {
+            _age = _particleManager->GetCurrentTime() - _dob;
+        }
+    }
+
     void Particle::Reset()
     {
         _age = 0;
@@ -186,9 +230,24 @@ namespace TLFX
         _emitter = e;
     }
 
+    void Particle::SetRandomSeed( unsigned int seed )
+    {
+        _randomState = seed ? seed : 0x9e3779b9u;
+    }
+
+    float Particle::RndVariation( float min, float max )
+    {
+        _randomState ^= _randomState << 13;
+        _randomState ^= _randomState >> 17;
+        _randomState ^= _randomState << 5;
+        return (max - min) * ((_randomState >> 8) * (1.0f / 16777216.0f)) + min;
+    }
+
     void Particle::SetParticleManager( ParticleManager *pm )
     {
         _particleManager = pm;
+        if (pm)
+            SetTimeContext(&pm->GetTimeContext());
     }
 
     void Particle::SetEffectLayer( int layer )
@@ -37,6 +37,20 @@ namespace TLFX
          */
         bool Update();
 
+        /**
+         * First half of #Update for particles without sub effects
+         * Ages and moves the particle and updates its own bounding box and radius. It doesn't touch the emitter, the effect or the
+         * particle manager, so it can run for many particles of the same emitter at the same time. See Emitter::UpdateParticlesParallel.
+         */
+        void UpdateLocal();
+
+        /**
+         * Second half of #Update for particles without sub effects
+         * Updates the bounding box and radius of the parents and releases the particle if it died. Has to be called serially.
+         * @return false if the particle died and was released to the particle manager
+         */
+        bool FinishUpdate();
+
         /**
          * Resets the particle so it's ready to be recycled by the particle manager
          */
@@ -103,7 +117,20 @@ namespace TLFX
 		void SetIter(ParticleList::iterator iter);
 		ParticleList::iterator GetIter() const;
 
+        /**
+         * Seed the random numbers used for the motion randomness of this particle
+         * Each particle has its own random sequence so particles can be controlled in parallel and still behave the same.
+         */
+        void SetRandomSeed(unsigned int seed);
+
+        /**
+         * Get a random number between min and max from the particle's own random sequence
+         */
+        float RndVariation(float min, float max);
+
     protected:
+        void UpdateAge();
+
         Emitter*                    _emitter;                       // emitter it belongs to
         // -----------------------------
         float                       _weightVariation;               // Particle weight variation
@@ -129,6 +156,7 @@ namespace TLFX
         int                         _effectLayer;
 		
 		ParticleList::iterator      _listIter;                      // for quick deletes from ParticleList
+        unsigned int                _randomState;                   // xorshift state for RndVariation
     };
 
 } // namespace TLFX
@@ -0,0 +1,47 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_PARTICLEINSTANCE_H
+#define _TLFX_PARTICLEINSTANCE_H
+
+namespace TLFX
+{
+
+    /**
+     * Particle Instance type
+     * <p>One particle of an instanced draw, written by ParticleManager::WriteInstances. The layout is part of the interface and won't
+     * change, so renderers can copy an array of instances straight into a per instance vertex buffer. 32 bytes, 4 byte aligned, no padding:</p>
+     * &{<pre>
+     * offset  type      field
+     *  0      float[2]  x, y      screen position of the top left corner of the sprite
+     *  8      float[2]  ux, uy    top edge, from the top left to the top right corner
+     * 16      float[2]  vx, vy    left edge, from the top left to the bottom left corner
+     * 24      uint32    color     RGBA8, red in the lowest byte
+     * 28      uint16    frame     animation frame of the sprite
+     * 30      uint16    sprite    AnimImage::GetIndex of the sprite, ORed with #instanceAdditive for additive blending
+     * </pre>}
+     * <p>The edges already hold rotation, scale, zoom and the particle handle, a corner of the quad is x,y + s * u + t * v for s and t of
+     * 0 or 1, so a vertex shader doesn't need any per sprite data besides the texture coordinates of the frame, see AnimImage::GetFrameUV.</p>
+     */
+    struct ParticleInstance
+    {
+        enum
+        {
+            instanceAdditive   = 0x8000,
+            instanceSpriteMask = 0x7fff
+        };
+
+        float           x, y;
+        float           ux, uy;
+        float           vx, vy;
+        unsigned int    color;
+        unsigned short  frame;
+        unsigned short  sprite;
+    };
+
+    static_assert(sizeof(ParticleInstance) == 32, "ParticleInstance layout is fixed");
+
+} // namespace TLFX
+
+#endif // _TLFX_PARTICLEINSTANCE_H
@@ -1,10 +1,12 @@
 #include "TLFXParticleManager.h"
+#include "TLFXBasicParticleManager.h"
 #include "TLFXEffect.h"
 #include "TLFXParticle.h"
 #include "TLFXEmitter.h"
 #include "TLFXAnimImage.h"
 #include "TLFXEffectsLibrary.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 
@@ -15,37 +17,13 @@ namespace TLFX
     float       ParticleManager::_globalAmountScale = 1.0f;
 
     ParticleManager::ParticleManager(int particles /*= particleLimit*/, int layers /*= 1*/)
-        : _originX(0)
-        , _originY(0)
-        , _originZ(1.0f)
-        , _oldOriginX(0)
-        , _oldOriginY(0)
-        , _oldOriginZ(1.0f)
-
-        , _angle(0)
-        , _oldAngle(0)
-
-        , _vpW(0)
-        , _vpH(0)
-        , _vpX(0)
-        , _vpY(0)
-        , _centerX(0)
-        , _centerY(0)
-
-        , _tv(0)
-        , _tx(0)
-        , _ty(0)
-        , _tz(0)
-        , _px(0)
-        , _py(0)
-
-        , _angleTweened(0)
+        : _drawListValid(false)
 
         , _localAmountScale(1.0f)
-
-        , _camtx(0)
-        , _camty(0)
-        , _camtz(0)
+        , _drawMicroseconds(0)
+        , _drawPixels(0)
+        , _drawCount(0)
+        , _timeContext(EffectsLibrary::GetDefaultTimeContext())
 
         , _spawningAllowed(true)
         , _testCount(0)
@@ -57,10 +35,23 @@ namespace TLFX
         , _idleTimeLimit(100)
 
         , _renderCount(0)
-        , _currentTween(0)
 
         , _effectLayers(0)
         , _inUseCount(0)
+
+        , _premultipliedAlpha(false)
+        , _depthSorted(false)
+
+        , _parallelUpdateThreshold(0)
+        , _scheduler(NULL)
+
+        , _pipelined(false)
+        , _snapshotWrite(0)
+        , _snapshotRead(1)
+        , _snapshotReady(2)
+
+        , _commands(new EffectCommandQueue(defaultCommandQueueCapacity))
+        , _nextHandle(1)
     {
         _inUse.resize(layers);
         _effects.resize(layers);
@@ -88,6 +79,7 @@ namespace TLFX
             delete _unused.top();
             _unused.pop();
         }
+        delete _commands;
         /*
         for (auto it = _inUse.begin(); it != _inUse.end(); ++it)
         {
@@ -112,9 +104,18 @@ namespace TLFX
 
     void ParticleManager::Update()
     {
+        bool governed = _governor.IsEnabled();
+        auto start = governed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+        ExecuteCommands();
+
+        // building the draw list takes about as long as walking the effects once, so it only pays when an update is drawn more than
+        // once: through several views, at a higher frame rate than the update rate, or paused. Pipelined draws sweep the snapshot instead.
+        bool drawList = !_pipelined && _drawCount.exchange(0, std::memory_order_relaxed) > 1;
+
         if (!_paused)
         {
-            _currentTime += EffectsLibrary::GetUpdateTime();
+            _currentTime += _timeContext.GetUpdateTime();
             ++_currentTick;
             TLFXLOG(PARTICLES, ("tick: %d time: %f", _currentTick, GetCurrentTime()));
             for (int el = 0; el < _effectLayers; ++el)
@@ -126,6 +127,7 @@ namespace TLFX
                     {
                         //RemoveEffect(*it);
                         auto x = *it;
+                        ForgetHandle(x);
                         delete x;
                         _effects[el].erase(it++);
                     }
@@ -134,9 +136,35 @@ namespace TLFX
                 }
             }
 
-            _oldOriginX = _originX;
-            _oldOriginY = _originY;
-            _oldOriginZ = _originZ;
+            _view.Tick();
+
+            if (_depthSorted)
+                SortByDepth();
+
+            if (drawList)
+                BuildDrawList();
+            else
+                _drawListValid = false;
+
+            if (_pipelined)
+                PublishSnapshot();
+        }
+        else if (!_drawListValid && !_pipelined)
+        {
+            BuildDrawList();                        // the same particles are drawn until unpaused
+        }
+
+        if (governed)
+        {
+            long long microseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+            microseconds += _drawMicroseconds.exchange(0, std::memory_order_relaxed);
+            float pixels = (float)_drawPixels.exchange(0, std::memory_order_relaxed);
+            if (!_paused)
+                _governor.Adjust(microseconds / 1000.0f, pixels);
+        }
+        else if (_governor.GetReason() != BudgetGovernor::reasonOff)
+        {
+            _governor.Reset();                      // budget was switched off
         }
     }
 
@@ -155,6 +183,7 @@ namespace TLFX
 
 		if(p)
 		{
+            _drawListValid = false;
             p->SetLayer(layer);
             p->SetGroupParticles(pool);
 
@@ -177,6 +206,7 @@ namespace TLFX
 
     void ParticleManager::ReleaseParticle( Particle *p )
     {
+        _drawListValid = false;
         --_inUseCount;
         _unused.push(p);
         if (!p->IsGroupParticles())
@@ -188,62 +218,245 @@ namespace TLFX
 
     void ParticleManager::DrawParticles( float tween /*= 1.0f*/, int layer /*= -1*/ )
     {
-        // tween origin
-        _currentTween = tween;
-        _camtx = -TweenValues(_oldOriginX, _originX, tween);
-        _camty = -TweenValues(_oldOriginY, _originY, tween);
-        _camtz =  TweenValues(_oldOriginZ, _originZ, tween);
-
-        // record current GFX states
-        /* not used
-        float cAlpha = GetAlpha();
-        float cRotation = GetRotation();
-        float cScaleX = GetScaleX();
-        float cScaleY = GetScaleY();
-        int cRed = GetR();
-        int cGreen = GetG();
-        int cBlue = GetB();
-        */
+        if (_pipelined)
+            AcquireSnapshot();
+
+        DrawParticles(GetDrawnView(), tween, layer);
+    }
+
+    void ParticleManager::DrawParticles( const View& view, float tween /*= 1.0f*/, int layer /*= -1*/ )
+    {
+        SpriteRenderer renderer = { *this };
+        DrawView(view, tween, layer, renderer);
+    }
+
+    int ParticleManager::WriteInstances( ParticleInstance* instances, int capacity, float tween /*= 1.0f*/, int layer /*= -1*/ )
+    {
+        if (_pipelined)
+            AcquireSnapshot();
+
+        return WriteInstances(GetDrawnView(), instances, capacity, tween, layer);
+    }
+
+    int ParticleManager::WriteInstances( const View& view, ParticleInstance* instances, int capacity, float tween /*= 1.0f*/, int layer /*= -1*/ ) const
+    {
+        assert(instances || capacity == 0);
+
+        // with no room at all particles are still counted
+        ParticleInstance none;
+        InstanceWriter writer = { capacity > 0 ? instances : &none, capacity, 0, _premultipliedAlpha };
+        DrawView(view, tween, layer, writer);
+
+        return writer.count;
+    }
+
+    void ParticleManager::AcquireSnapshot()
+    {
+        // pick up the latest published snapshot, otherwise keep the one we have
+        if (_snapshotReady.load(std::memory_order_relaxed) & snapshotFresh)
+            _snapshotRead = _snapshotReady.exchange(_snapshotRead, std::memory_order_acq_rel) & ~snapshotFresh;
+    }
+
+    const View& ParticleManager::GetDrawnView() const
+    {
+        // in pipelined mode the camera is drawn as it was when the snapshot was captured
+        return _pipelined ? _snapshots[_snapshotRead].view : _view;
+    }
+
+    void ParticleManager::TweenCamera( const View& view, float tween, DrawState& state )
+    {
+        state.tween = tween;
+        state.camtx = -TweenValues(view._oldOriginX, view._originX, tween);
+        state.camty = -TweenValues(view._oldOriginY, view._originY, tween);
+        state.camtz =  TweenValues(view._oldOriginZ, view._originZ, tween);
+        state.centerX = view._centerX;
+        state.centerY = view._centerY;
+        state.vpX = view._vpX;
+        state.vpY = view._vpY;
+        state.vpW = view._vpW;
+        state.vpH = view._vpH;
 
         // rendercount = 0
-        if (_angle != 0)
+        state.rotated = view._angle != 0;
+        state.angle = 0;
+        if (state.rotated)
         {
-            _angleTweened = TweenValues(_oldAngle, _angle, tween);
-            _matrix.Set(cosf(_angleTweened / 180.0f * (float)M_PI), sinf(_angleTweened / 180.0f * (float)M_PI), -sinf(_angleTweened / 180.0f * (float)M_PI), cosf(_angleTweened / 180.0f * (float)M_PI));
+            state.angle = TweenValues(view._oldAngle, view._angle, tween);
+            state.matrix.Set(cosf(state.angle / 180.0f * (float)M_PI), sinf(state.angle / 180.0f * (float)M_PI), -sinf(state.angle / 180.0f * (float)M_PI), cosf(state.angle / 180.0f * (float)M_PI));
         }
+    }
+
+    void ParticleManager::PublishSnapshot()
+    {
+        RenderSnapshot& snapshot = _snapshots[_snapshotWrite];
 
-        int layers = 0;
-        int startLayer = 0;
-        if (layer == -1 || layer >= _effectLayers)
+        // every effect layer is captured into its own list, so the layers can be captured in parallel
+        snapshot.layerParticles.resize(_effectLayers);
+        snapshot.effectParticles.resize(_effectLayers);
+        auto capture = [this, &snapshot](int begin, int end)
         {
-            layers = _effectLayers - 1;
-        }
+            for (int el = begin; el < end; ++el)
+            {
+                CaptureLayer(el, snapshot.layerParticles[el]);
+
+                auto& out = snapshot.effectParticles[el];
+                out.clear();
+                std::vector<EffectWalkFrame> stack;
+                for (auto it = _effects[el].begin(); it != _effects[el].end(); ++it)
+                {
+                    CaptureEffect(*it, out, stack);
+                }
+            }
+        };
+        if (IsParallelUpdate(_inUseCount))
+            GetTaskScheduler()->ParallelFor(_effectLayers, 1, capture);
         else
+            capture(0, _effectLayers);
+
+        snapshot.view = _view;
+        snapshot.tick = _currentTick;
+
+        _snapshotWrite = _snapshotReady.exchange(_snapshotWrite | snapshotFresh, std::memory_order_acq_rel) & ~snapshotFresh;
+    }
+
+    void ParticleManager::CaptureLayer( int layer, std::vector<RenderParticle>& out )
+    {
+        out.clear();
+        for (int i = 0; i < 10; ++i)
         {
-            layers = layer;
-            startLayer = layer;
+            auto& plist = _inUse[layer][i];
+            for (auto it = plist.begin(); it != plist.end(); ++it)
+            {
+                out.push_back(RenderParticle());
+                if (!CaptureParticle(*it, out.back()))
+                    out.pop_back();
+            }
         }
+    }
 
-        for (int el = startLayer; el <= layers; ++el)
+    void ParticleManager::CaptureEffect( Effect *e, std::vector<RenderParticle>& out, std::vector<EffectWalkFrame>& stack )
+    {
+        auto capture = [&out](Particle *p)
         {
-            for (int i = 0; i < 10; ++i)
+            out.push_back(RenderParticle());
+            if (!CaptureParticle(p, out.back()))
+                out.pop_back();
+        };
+        WalkEffect(e, capture, stack);
+    }
+
+    bool ParticleManager::HasSubEffects( Effect *effect )
+    {
+        const auto& emitters = effect->GetChildren();
+        for (auto it = emitters.begin(); it != emitters.end(); ++it)
+        {
+            if (!static_cast<Emitter*>(*it)->GetEffects().empty())
+                return true;
+        }
+        return false;
+    }
+
+    void ParticleManager::BuildDrawList()
+    {
+        _drawList.resize(_effectLayers);
+
+        std::vector<EffectWalkFrame> stack;
+        for (int el = 0; el < _effectLayers; ++el)
+        {
+            auto& list = _drawList[el];
+            list.clear();
+            auto append = [&list](Particle *p) { list.push_back(p); };
+            for (auto it = _effects[el].begin(); it != _effects[el].end(); ++it)
             {
-                auto& plist = _inUse[el][i];
-                for (auto it = plist.begin(); it != plist.end(); ++it)
-                {
-                    DrawParticle(*it);
-                }
+                WalkEffect(*it, append, stack);
             }
         }
-        DrawEffects();
-
-        // restore GFX states
-        /* not used
-        SetAlpha(cAlpha);
-        SetRotation(cRotation);
-        SetScale(cScaleX, cScaleY);
-        SetColor(cR, cG, cB);
-        */
+
+        _drawListValid = true;
+    }
+
+    void ParticleManager::SetPipelined( bool value )
+    {
+        _pipelined = value;
+        for (int i = 0; i < snapshotCount; ++i)
+            _snapshots[i].tick = 0;
+        _snapshotWrite = 0;
+        _snapshotRead = 1;
+        _snapshotReady.store(2);
+    }
+
+    bool ParticleManager::IsPipelined() const
+    {
+        return _pipelined;
+    }
+
+    void ParticleManager::SetPremultipliedAlpha( bool value )
+    {
+        _premultipliedAlpha = value;
+    }
+
+    bool ParticleManager::IsPremultipliedAlpha() const
+    {
+        return _premultipliedAlpha;
+    }
+
+    void ParticleManager::SetDepthSorted( bool value )
+    {
+        _depthSorted = value;
+    }
+
+    bool ParticleManager::IsDepthSorted() const
+    {
+        return _depthSorted;
+    }
+
+    const DepthSorter& ParticleManager::GetDepthSorter() const
+    {
+        return _depthSorter;
+    }
+
+    void ParticleManager::SortByDepth()
+    {
+        for (int el = 0; el < _effectLayers; ++el)
+        {
+            for (int i = 0; i < 10; ++i)
+                _depthSorter.Sort(_inUse[el][i]);
+
+            for (auto it = _effects[el].begin(); it != _effects[el].end(); ++it)
+                (*it)->SortParticles(_depthSorter);
+        }
+    }
+
+    void ParticleManager::SetParallelUpdateThreshold( int particles )
+    {
+        _parallelUpdateThreshold = particles;
+    }
+
+    int ParticleManager::GetParallelUpdateThreshold() const
+    {
+        return _parallelUpdateThreshold;
+    }
+
+    bool ParticleManager::IsParallelUpdate( int particles ) const
+    {
+        return _parallelUpdateThreshold > 0 && particles >= _parallelUpdateThreshold && GetTaskScheduler()->GetWorkerCount() > 1;
+    }
+
+    void ParticleManager::ParallelFor( int count, const TaskScheduler::RangeFunction& body )
+    {
+        const int grain = 1024;                     // not worth a task below this
+
+        GetTaskScheduler()->ParallelFor(count, grain, body);
+    }
+
+    void ParticleManager::SetTaskScheduler( TaskScheduler* scheduler )
+    {
+        _scheduler = scheduler;
+    }
+
+    TaskScheduler* ParticleManager::GetTaskScheduler() const
+    {
+        return _scheduler ? _scheduler : TaskScheduler::GetDefault();
     }
 
     void ParticleManager::DrawBoundingBoxes()
@@ -259,50 +472,47 @@ namespace TLFX
 
     void ParticleManager::SetOrigin( float x, float y, float z /*= 1.0f*/ )
     {
-        _oldOriginX = _originX;
-        _oldOriginY = _originY;
-        _oldOriginZ = _originZ;
-        _originX = x;
-        _originY = y;
-        _originZ = z;
+        _view.SetOrigin(x, y, z);
+    }
+
+    View& ParticleManager::GetView()
+    {
+        return _view;
+    }
+
+    const View& ParticleManager::GetView() const
+    {
+        return _view;
     }
 
     void ParticleManager::SetOriginX( float x )
     {
-        _oldOriginX = _originX;
-        _originX = x;
+        _view.SetOriginX(x);
     }
 
     void ParticleManager::SetOriginY( float y )
     {
-        _oldOriginY = _originY;
-        _originY = y;
+        _view.SetOriginY(y);
     }
 
     void ParticleManager::SetOriginZ( float z )
     {
-        _oldOriginZ = _originZ;
-        _originZ = z;
+        _view.SetOriginZ(z);
     }
 
     void ParticleManager::SetAngle( float angle )
     {
-        _oldAngle = _angle;
-        _angle = angle;
+        _view.SetAngle(angle);
     }
 
     void ParticleManager::SetScreenSize( int w, int h )
     {
-        _vpW = (float)w;
-        _vpH = (float)h;
-        _centerX = _vpW / 2.0f;
-        _centerY = _vpH / 2.0f;
+        _view.SetScreenSize(w, h);
     }
 
     void ParticleManager::SetScreenPosition( int x, int y )
     {
-        _vpX = (float)x;
-        _vpY = (float)y;
+        _view.SetScreenPosition(x, y);
     }
 
     void ParticleManager::SetIdleTimeLimit( int limit )
@@ -312,17 +522,17 @@ namespace TLFX
 
     float ParticleManager::GetOriginX() const
     {
-        return _originX;
+        return _view.GetOriginX();
     }
 
     float ParticleManager::GetOriginY() const
     {
-        return _originY;
+        return _view.GetOriginY();
     }
 
     float ParticleManager::GetOriginZ() const
     {
-        return _originZ;
+        return _view.GetOriginZ();
     }
 
     float ParticleManager::GetLocalAmountScale() const
@@ -340,11 +550,36 @@ namespace TLFX
         return _globalAmountScale;
     }
 
+    BudgetGovernor& ParticleManager::GetBudgetGovernor()
+    {
+        return _governor;
+    }
+
+    const BudgetGovernor& ParticleManager::GetBudgetGovernor() const
+    {
+        return _governor;
+    }
+
+    float ParticleManager::GetBudgetScale() const
+    {
+        return _governor.GetScale();
+    }
+
     void ParticleManager::SetGlobalAmountScale(float scale)
     {
         _globalAmountScale = scale;
     }
 
+    TimeContext& ParticleManager::GetTimeContext()
+    {
+        return _timeContext;
+    }
+
+    const TimeContext& ParticleManager::GetTimeContext() const
+    {
+        return _timeContext;
+    }
+
     int ParticleManager::GetParticlesInUse() const
     {
         return _inUseCount;
@@ -398,12 +633,12 @@ namespace TLFX
             layer = 0;
 
         float tempTime = _currentTime;
-        _currentTime -= frames * EffectsLibrary::GetUpdateTime();
+        _currentTime -= frames * _timeContext.GetUpdateTime();
         e->ChangeDoB(_currentTime);
 
         for (int i = 0; i < frames; ++i)
         {
-            _currentTime = (frames + 1) * EffectsLibrary::GetUpdateTime();
+            _currentTime = (frames + 1) * _timeContext.GetUpdateTime();
             e->Update();
             if (e->IsDestroyed())
                 RemoveEffect(e);
@@ -411,6 +646,7 @@ namespace TLFX
         _currentTime = tempTime;
         e->SetEffectLayer(layer);
         _effects[layer].insert(e);
+        _drawListValid = false;
     }
 
     void ParticleManager::AddEffect( Effect* e, int layer /*= 0*/ )
@@ -419,11 +655,122 @@ namespace TLFX
             layer = 0;
         e->SetEffectLayer(layer);
         _effects[layer].insert(e);
+        _drawListValid = false;
     }
 
     void ParticleManager::RemoveEffect( Effect* e )
     {
+        ForgetHandle(e);
         _effects[e->GetEffectLayer()].erase(e);
+        _drawListValid = false;
+    }
+
+    unsigned int ParticleManager::QueueSpawnEffect( const Effect* effect, float x, float y, int layer /*= 0*/ )
+    {
+        assert(effect);
+
+        EffectCommand command;
+        command.type = EffectCommand::spawn;
+        command.handle = _nextHandle.fetch_add(1, std::memory_order_relaxed);
+        if (command.handle == 0)                    // wrapped around
+            command.handle = _nextHandle.fetch_add(1, std::memory_order_relaxed);
+        command.effect = effect;
+        command.x = x;
+        command.y = y;
+        command.layer = layer;
+
+        return _commands->Push(command) ? command.handle : 0;
+    }
+
+    bool ParticleManager::QueueKillEffect( unsigned int handle, bool hard /*= false*/ )
+    {
+        EffectCommand command;
+        command.type = hard ? EffectCommand::hardKill : EffectCommand::softKill;
+        command.handle = handle;
+        command.effect = NULL;
+        command.x = command.y = 0;
+        command.layer = 0;
+
+        return _commands->Push(command);
+    }
+
+    bool ParticleManager::QueueMoveEffect( unsigned int handle, float x, float y )
+    {
+        EffectCommand command;
+        command.type = EffectCommand::move;
+        command.handle = handle;
+        command.effect = NULL;
+        command.x = x;
+        command.y = y;
+        command.layer = 0;
+
+        return _commands->Push(command);
+    }
+
+    Effect* ParticleManager::GetEffectByHandle( unsigned int handle ) const
+    {
+        auto it = _handles.find(handle);
+        return it != _handles.end() ? it->second : NULL;
+    }
+
+    void ParticleManager::SetCommandQueueCapacity( int capacity )
+    {
+        delete _commands;
+        _commands = new EffectCommandQueue(capacity);
+    }
+
+    int ParticleManager::GetCommandQueueCapacity() const
+    {
+        return _commands->GetCapacity();
+    }
+
+    void ParticleManager::ExecuteCommands()
+    {
+        EffectCommand command;
+        while (_commands->Pop(command))
+        {
+            if (command.type == EffectCommand::spawn)
+            {
+                Effect *e = new Effect(*command.effect, this);
+                e->SetPosition(command.x, command.y);
+                e->SetHandle(command.handle);
+                _handles[command.handle] = e;
+                AddEffect(e, command.layer);
+                continue;
+            }
+
+            Effect *e = GetEffectByHandle(command.handle);
+            if (!e)
+                continue;
+
+            switch (command.type)
+            {
+            case EffectCommand::softKill:
+                e->SoftKill();
+                break;
+
+            case EffectCommand::hardKill:
+                e->HardKill();
+                delete e;
+                break;
+
+            case EffectCommand::move:
+                e->SetPosition(command.x, command.y);
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    void ParticleManager::ForgetHandle( Effect *e )
+    {
+        if (e->GetHandle())
+        {
+            _handles.erase(e->GetHandle());
+            e->SetHandle(0);
+        }
     }
 
     void ParticleManager::ClearInUse()
@@ -444,6 +791,7 @@ namespace TLFX
                 plist.clear();
             }
         }
+        _drawListValid = false;
     }
 
     void ParticleManager::Destroy()
@@ -458,6 +806,7 @@ namespace TLFX
         {
             for (auto it = _effects[el].begin(); it != _effects[el].end(); ++it)
             {
+                ForgetHandle(*it);
                 (*it)->Destroy();
                 delete *it;
             }
@@ -471,6 +820,7 @@ namespace TLFX
 
         for (auto it = _effects[layer].begin(); it != _effects[layer].end(); ++it)
         {
+            ForgetHandle(*it);
             (*it)->Destroy();
             delete (*it);
         }
@@ -504,162 +854,103 @@ namespace TLFX
 		_paused = false;
 	}
 
-    float ParticleManager::TweenValues( float oldValue, float value, float tween )
+    void ParticleManager::GetSpriteEdges( AnimImage* sprite, float px, float py, float x, float y, float rotation, float scaleX, float scaleY,
+                                          float& cornerX, float& cornerY, float& ux, float& uy, float& vx, float& vy )
     {
-        return oldValue + (value - oldValue) * tween;
-    }
+        float radians = rotation * (float)M_PI / 180.0f;
+        float c = cosf(radians), s = sinf(radians);
+        float width = sprite->GetWidth() * scaleX, height = sprite->GetHeight() * scaleY;
+        float hx = -x * scaleX, hy = -y * scaleY;
 
-    void ParticleManager::DrawEffects()
-    {
-        for (auto it = _effects.begin(); it != _effects.end(); ++it)
-        {
-            for (auto it2 = it->begin(); it2 != it->end(); ++it2)
-            {
-                DrawEffect(*it2);
-            }
-        }
+        cornerX = px + hx * c - hy * s;
+        cornerY = py + hx * s + hy * c;
+        ux = width * c;
+        uy = width * s;
+        vx = -height * s;
+        vy = height * c;
     }
 
-    void ParticleManager::DrawEffect( Effect *e )
+    void ParticleManager::SpriteRenderer::DrawSprite( AnimImage* sprite, float px, float py, float frame, float x, float y, float rotation,
+                                                      float scaleX, float scaleY, unsigned char r, unsigned char g, unsigned char b, float a, bool additive )
     {
-        for (int i = 0; i < 10; ++i)
-        {
-            // particle
-            const auto& plist = e->GetParticles(i);
-            for (auto it = plist.begin(); it != plist.end(); ++it)
-            {
-                DrawParticle(*it);
-                // effect
-                auto& subeffects = (*it)->GetChildren();
-                for (auto it2 = subeffects.begin(); it2 != subeffects.end(); ++it2)
-                {
-                    DrawEffect(static_cast<Effect*>(*it2));
-                }
-            }
-        }
+        manager.DrawSprite(sprite, px, py, frame, x, y, rotation, scaleX, scaleY, r, g, b, a, additive);
     }
 
-    void ParticleManager::DrawParticle( Particle *p )
+    void ParticleManager::InstanceWriter::DrawSprite( AnimImage* sprite, float px, float py, float frame, float x, float y, float rotation,
+                                                      float scaleX, float scaleY, unsigned char r, unsigned char g, unsigned char b, float a, bool additive )
     {
-        if (p->GetAge() != 0 || p->GetEmitter()->IsSingleParticle())
-        {
-            _px = TweenValues(p->GetOldWX(), p->GetWX(), _currentTween);
-            _py = TweenValues(p->GetOldWY(), p->GetWY(), _currentTween);
-
-            if (_angle != 0)
-            {
-                Vector2 rotVec = _matrix.TransformVector(Vector2(_px, _py));
-                _px = (rotVec.x * _camtz) + _centerX + (_camtz * _camtx);
-                _py = (rotVec.y * _camtz) + _centerY + (_camtz * _camty);
-            }
-            else
-            {
-                _px = (_px * _camtz) + _centerX + (_camtz * _camtx);
-                _py = (_py * _camtz) + _centerY + (_camtz * _camty);
-            }
+        unsigned int alpha = (unsigned int)(std::min(std::max(a, 0.0f), 1.0f) * 255);
+        if (alpha == 0 && !premultipliedAlpha)
+            return;                                 // premultiplied particles are culled by DrawRenderParticle
 
-            if (_px > _vpX - p->GetImageDiameter() && _px < _vpX + _vpW + p->GetImageDiameter() && _py > _vpY - p->GetImageDiameter() && _py < _vpY + _vpH + p->GetImageDiameter())
-            {
-                if (p->GetAvatar())
-                {
-                    AnimImage *sprite;
-                    float x, y;
+        if (count++ >= capacity)
+            return;                                 // only counted
+        ParticleInstance& instance = instances[count - 1];
 
-                    if (p->GetEmitter()->IsHandleCenter())
-                    {
-                        if (p->GetAvatar()->GetFramesCount() == 1)
-                        {
-                            //MidHandleImage(p->GetAvatar()->GetImage());
-                            sprite = p->GetAvatar();
-                            x = sprite->GetWidth() / 2.0f;
-                            y = sprite->GetHeight() / 2.0f;
-                        }
-                        else
-                        {
-                            //SetImageHandle(p->GetAvatar()->GetImage(), p->GetAvatar()->GetWidth() / 2.f, p->GetAvatar()->GetHeight() / 2.f);
-                            sprite = p->GetAvatar();
-                            x = sprite->GetWidth() / 2.0f;
-                            y = sprite->GetHeight() / 2.0f;
-                        }
-                    }
-                    else
-                    {
-                        //SetImageHandle(p->GetAvatar()->GetImage(), p->GetHandleX(), p->GetHandleY());
-                        sprite = p->GetAvatar();
-                        x = (float)p->GetHandleX();
-                        y = (float)p->GetHandleY();
-                    }
-
-                    //SetBlend(p->GetEmitter()->GetBlendMode());
-                    Emitter::BlendMode blend = p->GetEmitter()->GetBlendMode();
-
-                    float rotation;
-
-					if (p->GetEmitter()->IsAngleRelative())
-                    {
-                        if (fabsf(p->GetOldRelativeAngle() - p->GetRelativeAngle()) > 180)
-                            _tv = TweenValues(p->GetOldRelativeAngle() - 360, p->GetRelativeAngle(), _currentTween);
-                        else
-                            _tv = TweenValues(p->GetOldRelativeAngle(), p->GetRelativeAngle(), _currentTween);
-						rotation = _tv + _angleTweened;
-                    }
-                    else
-					{
-						_tv = TweenValues(p->GetOldAngle(), p->GetAngle(), _currentTween);
-                        rotation = _tv + _angleTweened;
-                    }
+        GetSpriteEdges(sprite, px, py, x, y, rotation, scaleX, scaleY, instance.x, instance.y, instance.ux, instance.uy, instance.vx, instance.vy);
+        instance.color = r | (g << 8) | (b << 16) | (alpha << 24);
+        instance.frame = (unsigned short)frame;
+        instance.sprite = (unsigned short)((sprite->GetIndex() & ParticleInstance::instanceSpriteMask) | (additive ? ParticleInstance::instanceAdditive : 0));
+    }
 
-                    float scaleX, scaleY;
+    bool ParticleManager::CaptureParticle( Particle *p, RenderParticle& out )
+    {
+        if (!p->GetAvatar() || (p->GetAge() == 0 && !p->GetEmitter()->IsSingleParticle()))
+            return false;
 
-                    _tx = TweenValues(p->GetOldScaleX(), p->GetScaleX(), _currentTween);
-                    _ty = TweenValues(p->GetOldScaleY(), p->GetScaleY(), _currentTween);
-                    _tz = TweenValues(p->GetOldZ(), p->GetZ(), _currentTween);
-                    if (_tz != 1.0f)
-                    {
-                        //SetScale(_tx * _tz * _camtz, _ty * _tz * _camtz);
-                        scaleX = _tx * _tz * _camtz;
-                        scaleY = _ty * _tz * _camtz;
-                    }
-                    else
-                    {
-                        //SetScale(_tx * _camtz, _ty * _camtz);
-                        scaleX = _tx * _camtz;
-                        scaleY = _ty * _camtz;
-                    }
+        out.sprite = p->GetAvatar();
+        out.wx = p->GetWX();
+        out.wy = p->GetWY();
+        out.oldWX = p->GetOldWX();
+        out.oldWY = p->GetOldWY();
 
-                    unsigned char r, g, b;
-                    float a;
-                    //SetAlpha(p->GetAlpha());
-                    //SetColor(p->GetRed(), p->GetGreen(), p->GetBlue());
-                    a = p->GetEntityAlpha();
-                    r = p->GetRed();
-                    g = p->GetGreen();
-                    b = p->GetBlue();
+        if (p->GetEmitter()->IsHandleCenter())
+        {
+            //MidHandleImage(p->GetAvatar()->GetImage());
+            out.handleX = out.sprite->GetWidth() / 2.0f;
+            out.handleY = out.sprite->GetHeight() / 2.0f;
+        }
+        else
+        {
+            //SetImageHandle(p->GetAvatar()->GetImage(), p->GetHandleX(), p->GetHandleY());
+            out.handleX = (float)p->GetHandleX();
+            out.handleY = (float)p->GetHandleY();
+        }
 
-                    if (p->IsAnimating())
-                    {
-                        _tv = TweenValues(p->GetOldCurrentFrame(), p->GetCurrentFrame(), _currentTween);
-                        if (_tv < 0)
-                        {
-                            _tv = p->GetAvatar()->GetFramesCount() + (fmodf(_tv, (float)p->GetAvatar()->GetFramesCount()));
-                            if (_tv == p->GetAvatar()->GetFramesCount())
-                                _tv = 0;
-                        }
-                        else
-                        {
-                            _tv = fmodf(_tv, (float)p->GetAvatar()->GetFramesCount());
-                        }
-                    }
-                    else
-                    {
-                        _tv = p->GetCurrentFrame();
-                    }
-					
-                    DrawSprite(sprite, _px, _py, _tv, x, y, rotation, scaleX, scaleY, r, g, b, a, blend == Emitter::BMLightBlend);
-                    // ++rendercount
-                }
-            }
+        if (p->GetEmitter()->IsAngleRelative())
+        {
+            out.angle = p->GetRelativeAngle();
+            out.oldAngle = p->GetOldRelativeAngle();
+            if (fabsf(out.oldAngle - out.angle) > 180)
+                out.oldAngle -= 360;
         }
+        else
+        {
+            out.angle = p->GetAngle();
+            out.oldAngle = p->GetOldAngle();
+        }
+
+        out.scaleX = p->GetScaleX();
+        out.scaleY = p->GetScaleY();
+        out.oldScaleX = p->GetOldScaleX();
+        out.oldScaleY = p->GetOldScaleY();
+        out.z = p->GetZ();
+        out.oldZ = p->GetOldZ();
+        out.frame = p->GetCurrentFrame();
+        out.oldFrame = p->GetOldCurrentFrame();
+        out.animating = p->IsAnimating();
+        out.imageDiameter = p->GetImageDiameter();
+
+        //SetAlpha(p->GetAlpha());
+        //SetColor(p->GetRed(), p->GetGreen(), p->GetBlue());
+        out.alpha = p->GetEntityAlpha();
+        out.r = p->GetRed();
+        out.g = p->GetGreen();
+        out.b = p->GetBlue();
+
+        //SetBlend(p->GetEmitter()->GetBlendMode());
+        out.additive = p->GetEmitter()->GetBlendMode() == Emitter::BMLightBlend;
+        return true;
     }
 
     int ParticleManager::GetIdleTimeLimit() const
@@ -674,7 +965,7 @@ namespace TLFX
 
     float ParticleManager::GetCurrentTime() const
     {
-        return _currentTick * EffectsLibrary::GetUpdateTime();
+        return _currentTick * _timeContext.GetUpdateTime();
     }
 
 } // namespace TLFX
@@ -7,16 +7,28 @@
 
 #include "TLFXMatrix2.h"
 #include "TLFXVector2.h"
+#include "TLFXTimeContext.h"
+#include "TLFXRenderSnapshot.h"
+#include "TLFXParticleInstance.h"
+#include "TLFXTaskScheduler.h"
+#include "TLFXEffectCommandQueue.h"
+#include "TLFXDepthSorter.h"
+#include "TLFXBudgetGovernor.h"
+#include "TLFXView.h"
 
 #include <vector>
 #include <set>
+#include <map>
 #include <list>
 #include <stack>
 #include <string>
+#include <atomic>
+#include <chrono>
 
 namespace TLFX
 {
 
+    class Entity;
     class Particle;
     class Effect;
     class AnimImage;
@@ -97,8 +109,114 @@ namespace TLFX
          */
         virtual void DrawParticles(float tween = 1.0f, int layer = -1);
 
+        /**
+         * Draw all particles currently in use through another view
+         * <p>Draws like #DrawParticles, with the camera, viewport and culling of view instead of the view of the particle manager, see #GetView.
+         * Nothing is stored in the particle manager while drawing, so several views of the same update can be drawn one after the other,
+         * or written in parallel with #WriteInstances. Only #DrawSprite has to be re-entrant when integrations draw on several threads.</p>
+         * <p>In pipelined mode call #AcquireSnapshot once per frame before drawing views, so that every view draws the same update.</p>
+         */
+        virtual void DrawParticles(const View& view, float tween = 1.0f, int layer = -1);
+
+        /**
+         * Write the particles #DrawParticles would draw as instance records, for instanced rendering
+         * <p>Instead of calling #DrawSprite every visible particle is written to instances as one #ParticleInstance, in the same order and
+         * with the same tweening, culling and camera as #DrawParticles. A renderer then draws all of them with one instanced quad per
+         * batch of the same texture and blend mode, and uploads a quarter of the data four vertices per particle take.</p>
+         * <p>Fully transparent particles are left out. Works in pipelined mode too, drawing the latest snapshot.</p>
+         * @return the number of particles visible, if more than capacity only the first capacity were written
+         */
+        int WriteInstances(ParticleInstance* instances, int capacity, float tween = 1.0f, int layer = -1);
+
+        /**
+         * Write the particles visible in view as instance records
+         * Works like #WriteInstances with the camera and culling of view. This doesn't change the particle manager, any number of threads
+         * can write instances for different views at the same time, as long as #Update doesn't run on the same particles (it may in
+         * pipelined mode, see #AcquireSnapshot).
+         */
+        int WriteInstances(const View& view, ParticleInstance* instances, int capacity, float tween = 1.0f, int layer = -1) const;
+
+        /**
+         * In pipelined mode, pick up the latest snapshot published by #Update for the draws that follow
+         * #DrawParticles and #WriteInstances without a view do this themselves. Draws with a view keep drawing the snapshot picked up last,
+         * so views drawn in the same frame show the same update. Call it from the thread drawing, not while drawing.
+         */
+        void AcquireSnapshot();
+
+        /**
+         * Get where a sprite drawn with the #DrawSprite parameters lands on the screen
+         * The top left corner of the frame is at cornerX,cornerY and u and v are its top and left edge, a point s,t of the frame from 0 to 1
+         * is at corner + s * u + t * v. Integrations drawing trimmed frames place the points of AnimImage::GetFrameHull with it.
+         */
+        static void GetSpriteEdges(AnimImage* sprite, float px, float py, float x, float y, float rotation, float scaleX, float scaleY,
+            float& cornerX, float& cornerY, float& ux, float& uy, float& vx, float& vy);
+
         void DrawBoundingBoxes();
 
+        /**
+         * Enable or disable pipelined rendering
+         * <p>When pipelined, #Update captures every particle into a #RenderSnapshot at the end of each tick and #DrawParticles draws the most
+         * recently published snapshot instead of reading the live particles. #Update and #DrawParticles can then run at the same time on
+         * different threads, giving a full frame of overlap between simulation and building the draw calls.</p>
+         * <p>Three snapshots are used so that neither thread ever waits for the other: one being written by #Update, one being drawn and one
+         * holding the latest published tick. #DrawParticles draws nothing until the first snapshot is published.
+         * Only change this while neither #Update nor #DrawParticles is running.</p>
+         */
+        void SetPipelined(bool value);
+        bool IsPipelined() const;
+
+        /**
+         * Enable or disable premultiplied alpha output
+         * <p>Off by default. When on, #DrawSprite and #WriteInstances get colors already multiplied by alpha, and additive particles come
+         * with an alpha of 0 and additive false. Drawn with a single ONE, ONE_MINUS_SRC_ALPHA blend state over premultiplied textures, additive
+         * particles then add their color while alpha blended ones cover what's behind them as before, so particles of both blend modes can
+         * share a batch and the integration no longer has to flush whenever the blend mode changes. Draw order and the result on screen
+         * stay the same.</p>
+         * <p>Since additive particles have no alpha, integrations must not skip particles by alpha in this mode. Particles that are fully
+         * transparent are left out before #DrawSprite instead.</p>
+         */
+        void SetPremultipliedAlpha(bool value);
+        bool IsPremultipliedAlpha() const;
+
+        /**
+         * Enable or disable drawing particles sorted by z
+         * <p>Off by default, particles are then drawn in the order they were spawned within their effect layer and z layer. When on, #Update
+         * sorts them by their z (zoom), lowest first, so particles further away are drawn behind closer ones in pseudo 3D effects. Effect
+         * layers, z layers and effects that group their particles are still drawn in the same order, only the particles inside each list move.</p>
+         * <p>The order is kept from one update to the next and only fixed up where z changed, see DepthSorter.</p>
+         */
+        void SetDepthSorted(bool value);
+        bool IsDepthSorted() const;
+        const DepthSorter& GetDepthSorter() const;
+
+        /**
+         * Set the particle count above which an emitter updates its particles in parallel
+         * Emitters with at least this many particles split them into chunks that are updated on all available cores, see
+         * Emitter::UpdateParticlesParallel. This only pays off for very big emitters, like a weather effect with tens of thousands of
+         * particles. A value of 0 (the default) always updates particles serially.
+         */
+        void SetParallelUpdateThreshold(int particles);
+        int GetParallelUpdateThreshold() const;
+
+        /**
+         * Whether an emitter with this many particles should use Emitter::UpdateParticlesParallel
+         * Always false when the task scheduler has a single worker, where the extra pass would only cost time.
+         */
+        bool IsParallelUpdate(int particles) const;
+
+        /**
+         * Run body over the range [0, count) split into chunks on the task scheduler
+         * body is called with the begin and end index of each chunk and must not touch anything shared by other chunks.
+         */
+        void ParallelFor(int count, const TaskScheduler::RangeFunction& body);
+
+        /**
+         * Set the task scheduler used for all parallel work of this particle manager
+         * The scheduler is not owned by the particle manager and has to outlive it. Pass NULL to use TaskScheduler::GetDefault.
+         */
+        void SetTaskScheduler(TaskScheduler* scheduler);
+        TaskScheduler* GetTaskScheduler() const;
+
         /**
          * Set the Origin of the particle Manager.
          * An origin at 0,0 represents the center of the screen assuming you have called #SetScreenSize. Passing a z value will zoom in or out. Values above 1
@@ -106,6 +224,14 @@ namespace TLFX
          */
         void SetOrigin(float x, float y, float z = 1.0f);
 
+        /**
+         * Get the view of the particle manager
+         * The camera and viewport set with #SetOrigin, #SetAngle, #SetScreenSize and #SetScreenPosition, drawn by #DrawParticles. Copy it
+         * as the starting point of other views.
+         */
+        View& GetView();
+        const View& GetView() const;
+
         /**
          * Set the x origin
          * See #SetOrigin
@@ -196,6 +322,35 @@ namespace TLFX
          */
         static void SetGlobalAmountScale(float scale);
 
+        /**
+         * Get the governor that holds this particle manager to a frame budget
+         * <p>Set a target time, a pixel budget or both and every #Update measures how long it and the #DrawParticles calls since the last
+         * update took, and how many pixels the drawn sprites covered. The governor turns that into a budget scale applied to the amount
+         * of particles spawned on top of the local and global amount scale, weighted per effect by Effect::SetBudgetWeight. For example
+         * to keep the particles under 2 milliseconds per update:</p>
+         * &{myParticleManager->GetBudgetGovernor().SetTargetTime(2.0f)}
+         * <p>The time of both #Update and #DrawParticles counts, also when they run on different threads in pipelined mode, so the budget
+         * is CPU time rather than the length of a frame. Time spent in the integration after #DrawParticles, like submitting batches, isn't
+         * measured.</p>
+         */
+        BudgetGovernor& GetBudgetGovernor();
+        const BudgetGovernor& GetBudgetGovernor() const;
+
+        /**
+         * Get the scale of the budget governor, 1 when no budget is set
+         */
+        float GetBudgetScale() const;
+
+        /**
+         * Get the time context of the particle manager
+         * The time context holds the update frequency used by every effect managed by this particle manager. The lookup frequencies are
+         * library wide, see EffectsLibrary::SetLookupFrequency.
+         * It starts as a copy of EffectsLibrary::GetDefaultTimeContext, change it before adding effects to run this manager at its own rate, for example:
+         * &{myParticleManager->GetTimeContext().SetUpdateFrequency(60)}
+         */
+        TimeContext& GetTimeContext();
+        const TimeContext& GetTimeContext() const;
+
         /**
          * Get the current number of particles in use
          */
@@ -238,6 +393,43 @@ namespace TLFX
          */
         void RemoveEffect(Effect* effect);
 
+        /**
+         * Queue a copy of an effect to be spawned at the start of the next #Update
+         * <p>Unlike #AddEffect this can be called from any thread, any number of threads can queue commands while another thread updates
+         * the particle manager. Queueing never locks and never allocates, the effect is copied from the template and added to the given layer
+         * when the queue is drained at the start of #Update. The template has to stay alive until then.</p>
+         * @return a handle to use with #QueueKillEffect and #QueueMoveEffect, or 0 if the command queue is full
+         */
+        unsigned int QueueSpawnEffect(const Effect* effect, float x, float y, int layer = 0);
+
+        /**
+         * Queue killing an effect spawned with #QueueSpawnEffect
+         * A soft kill lets the remaining particles die, a hard kill removes the effect and its particles immediately. Can be called from any thread.
+         * Handles of effects that have already been removed are ignored.
+         * @return false if the command queue is full
+         */
+        bool QueueKillEffect(unsigned int handle, bool hard = false);
+
+        /**
+         * Queue moving an effect spawned with #QueueSpawnEffect
+         * Can be called from any thread.
+         * @return false if the command queue is full
+         */
+        bool QueueMoveEffect(unsigned int handle, float x, float y);
+
+        /**
+         * Get the effect spawned with the handle, or NULL if it isn't spawned yet or was removed
+         * Only call this from the thread updating the particle manager.
+         */
+        Effect* GetEffectByHandle(unsigned int handle) const;
+
+        /**
+         * Set the number of commands that can be queued between two updates, the default is 1024
+         * Only call this while no other thread is queueing commands, any queued commands are dropped.
+         */
+        void SetCommandQueueCapacity(int capacity);
+        int GetCommandQueueCapacity() const;
+
         /**
          * Clear all particles in use
          * Call this method to empty the list of in use particles and move them to the unused list.
@@ -293,7 +485,7 @@ namespace TLFX
          * Interpolate between 2 values
          * This is the function used to achieve render tweening by taking the old and new values and interpolating between the 2
          */
-        float TweenValues(float oldValue, float value, float tween);
+        static float TweenValues(float oldValue, float value, float tween)  { return oldValue + (value - oldValue) * tween; }
 
         float GetCurrentTime() const;
 
@@ -306,25 +498,20 @@ namespace TLFX
 
         std::vector<std::set<Effect*> >      _effects;
 
-        float                                _originX, _originY, _originZ;
-        float                                _oldOriginX, _oldOriginY, _oldOriginZ;
-
-        float                                _angle;
-        float                                _oldAngle;
+        // particles grouped with their effects in draw order per effect layer, sub effects flattened in. Built by Update when the
+        // update before was drawn more than once, see BuildDrawList
+        std::vector<std::vector<Particle*> > _drawList;
+        bool                                 _drawListValid;         // built, and no particle or effect added or removed since
 
-        Matrix2                              _matrix;
-        Vector2                              _rotVec;
-
-        float                                _vpW, _vpH, _vpX, _vpY;
-        float                                _centerX, _centerY;
-
-        float                                _tv, _tx, _ty, _tz, _px, _py;
-        float                                _angleTweened;
+        View                                 _view;
 
         float                                _localAmountScale; // only effects managed by this
         static float                         _globalAmountScale; // all managers
-
-        float                                _camtx, _camty, _camtz;
+        BudgetGovernor                       _governor;
+        mutable std::atomic<long long>       _drawMicroseconds;  // DrawParticles since the last Update, for the governor
+        mutable std::atomic<long long>       _drawPixels;
+        mutable std::atomic<int>             _drawCount;        // DrawParticles since the last Update, see BuildDrawList
+        TimeContext                          _timeContext;      // update rate of this manager
 
         bool                                 _spawningAllowed;
         int                                  _testCount;
@@ -336,14 +523,104 @@ namespace TLFX
         int                                  _idleTimeLimit;         // The time in game ticks before idle effects are automatically deleted
 
         int                                  _renderCount;
-        float                                _currentTween;
 
         int                                  _effectLayers;
 
+        bool                                 _premultipliedAlpha;
+        bool                                 _depthSorted;
+        DepthSorter                          _depthSorter;
+
+        int                                  _parallelUpdateThreshold;
+        TaskScheduler*                       _scheduler;             // NULL for TaskScheduler::GetDefault
+
+        // pipelined rendering, see SetPipelined
+        enum { snapshotCount = 3, snapshotFresh = 0x4 };
+        bool                                 _pipelined;
+        RenderSnapshot                       _snapshots[snapshotCount];
+        int                                  _snapshotWrite;         // owned by Update
+        int                                  _snapshotRead;          // owned by DrawParticles
+        std::atomic<int>                     _snapshotReady;         // latest published snapshot, snapshotFresh until drawn
+
+        // command queue, see QueueSpawnEffect
+        enum { defaultCommandQueueCapacity = 1024 };
+        EffectCommandQueue*                  _commands;
+        std::atomic<unsigned int>            _nextHandle;
+        std::map<unsigned int, Effect*>      _handles;               // effects spawned from the queue, owned by Update
+
+        // everything a single draw of a view needs, kept on the stack so views can be drawn at the same time
+        struct DrawState
+        {
+            float               tween;
+            float               camtx, camty, camtz;
+            bool                rotated;            // camera angle is not 0
+            float               angle;
+            Matrix2             matrix;
+            float               centerX, centerY;
+            float               vpX, vpY, vpW, vpH;
+
+            bool                countPixels;        // when the governor has a pixel budget
+            float               pixels;
+        };
+
         // internal methods
-        void DrawEffects();
-        void DrawEffect(Effect *effect);
-        void DrawParticle(Particle *particle);
+        void ExecuteCommands();
+        void SortByDepth();
+        void BuildDrawList();
+        void ForgetHandle(Effect *effect);
+
+        // renderers the draw templates pass every visible particle to, see BasicParticleManager for the inlined one
+        struct SpriteRenderer
+        {
+            ParticleManager&    manager;
+
+            void DrawSprite(AnimImage* sprite, float px, float py, float frame, float x, float y, float rotation,
+                float scaleX, float scaleY, unsigned char r, unsigned char g, unsigned char b, float a, bool additive);
+        };
+
+        struct InstanceWriter
+        {
+            ParticleInstance*   instances;
+            int                 capacity;
+            int                 count;
+            bool                premultipliedAlpha;
+
+            void DrawSprite(AnimImage* sprite, float px, float py, float frame, float x, float y, float rotation,
+                float scaleX, float scaleY, unsigned char r, unsigned char g, unsigned char b, float a, bool additive);
+        };
+
+        const View& GetDrawnView() const;
+        static void TweenCamera(const View& view, float tween, DrawState& state);
+
+        // position in the particles of an effect while walking it, see WalkEffect
+        struct EffectWalkFrame
+        {
+            Effect*                                 effect;
+            int                                     layer;
+            ParticleList::const_iterator            particle;
+            std::list<Entity*>::const_iterator      child;          // sub effects of *particle still to walk
+            std::list<Entity*>::const_iterator      childEnd;
+            bool                                    inChildren;
+        };
+
+        // whether particles of the effect can carry sub effects, see Emitter::GetEffects
+        static bool HasSubEffects(Effect *effect);
+
+        // pass the particles of an effect to visit in the order the effect is drawn: every particle followed by the particles of its
+        // sub effects. Sub effects can nest arbitrarily deep, so they're walked with the stack rather than by recursion.
+        template <class Visitor> static void WalkEffect(Effect *effect, Visitor& visit, std::vector<EffectWalkFrame>& stack);
+
+        // draw templates, defined in TLFXBasicParticleManager.h
+        template <class Renderer> void DrawView(const View& view, float tween, int layer, Renderer& renderer) const;
+        template <class Renderer> void DrawLayers(DrawState& state, int layer, Renderer& renderer) const;
+        template <class Renderer> void DrawEffect(DrawState& state, Effect *effect, std::vector<EffectWalkFrame>& stack, Renderer& renderer) const;
+        template <class Renderer> void DrawParticle(DrawState& state, Particle *particle, Renderer& renderer) const;
+        template <class Renderer> void DrawSnapshot(DrawState& state, const RenderSnapshot& snapshot, int layer, Renderer& renderer) const;
+        template <class Renderer> void DrawRenderParticle(DrawState& state, const RenderParticle& rp, Renderer& renderer) const;
+
+        void PublishSnapshot();
+        void CaptureLayer(int layer, std::vector<RenderParticle>& out);
+        void CaptureEffect(Effect *effect, std::vector<RenderParticle>& out, std::vector<EffectWalkFrame>& stack);
+        static bool CaptureParticle(Particle *particle, RenderParticle& out);
 
         virtual void DrawSprite(AnimImage* sprite, float px, float py, float frame, float x, float y, float rotation,
             float scaleX, float scaleY, unsigned char r, unsigned char g, unsigned char b, float a, bool additive) = 0;
@@ -0,0 +1,58 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_RENDERSNAPSHOT_H
+#define _TLFX_RENDERSNAPSHOT_H
+
+#include "TLFXView.h"
+
+#include <vector>
+
+namespace TLFX
+{
+
+    class AnimImage;
+
+    /**
+     * Render Particle type
+     * <p>A compact copy of everything #ParticleManager needs to draw a particle: the current and previous world position, angle, scale,
+     * zoom and animation frame for tweening, plus color, sprite and blend mode. Particles are captured into this type at the end of an
+     * update so they can be drawn while the next update is already changing the live particles.</p>
+     */
+    struct RenderParticle
+    {
+        AnimImage*      sprite;
+        float           wx, wy;
+        float           oldWX, oldWY;
+        float           angle, oldAngle;            // relative or absolute angle depending on the emitter
+        float           scaleX, scaleY;
+        float           oldScaleX, oldScaleY;
+        float           z, oldZ;
+        float           frame, oldFrame;
+        float           handleX, handleY;
+        float           imageDiameter;
+        float           alpha;
+        unsigned char   r, g, b;
+        bool            animating;
+        bool            additive;
+    };
+
+    /**
+     * Render Snapshot type
+     * <p>All particles captured by one update, in draw order, together with the camera of the particle manager at that time.
+     * Particles that are not grouped with their effect are stored per effect layer, grouped particles of every effect follow in
+     * #effectParticles, again per effect layer, matching the order #ParticleManager::DrawParticles uses.</p>
+     */
+    struct RenderSnapshot
+    {
+        std::vector<std::vector<RenderParticle> >   layerParticles;
+        std::vector<std::vector<RenderParticle> >   effectParticles;
+
+        View            view;
+        int             tick;
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_RENDERSNAPSHOT_H
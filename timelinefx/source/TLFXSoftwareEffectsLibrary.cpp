@@ -0,0 +1,811 @@
+#include "TLFXSoftwareEffectsLibrary.h"
+#include "TLFXPugiXMLLoader.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define TLFX_SOFTWARE_SSE2
+#endif
+
+namespace TLFX
+{
+
+    XMLLoader* SoftwareEffectsLibrary::CreateLoader() const
+    {
+        return new PugiXMLLoader(0);
+    }
+
+    AnimImage* SoftwareEffectsLibrary::CreateImage() const
+    {
+        return new SoftwareImage();
+    }
+
+
+
+    bool SoftwareImage::Load( const char *filename )
+    {
+        std::vector<unsigned char> rgba;
+        int width, height;
+        if (!Decode(filename, rgba, width, height))
+        {
+            TLFXLOG(EFFECTS, ("can't read image %s", filename));
+            return false;
+        }
+
+        SetPixels(&rgba[0], width, height);
+        return true;
+    }
+
+    void SoftwareImage::SetPixels( const unsigned char *rgba, int width, int height )
+    {
+        assert(rgba && width > 0 && height > 0);
+
+        _pixels.resize(width * height * 4);
+        for (size_t i = 0; i < _pixels.size(); i += 4)
+        {
+            unsigned int alpha = rgba[i + 3];
+            _pixels[i + 0] = (unsigned char)((rgba[i + 0] * alpha + 127) / 255);
+            _pixels[i + 1] = (unsigned char)((rgba[i + 1] * alpha + 127) / 255);
+            _pixels[i + 2] = (unsigned char)((rgba[i + 2] * alpha + 127) / 255);
+            _pixels[i + 3] = (unsigned char)alpha;
+        }
+        SetTextureSize(width, height);
+    }
+
+    bool SoftwareImage::Trim( int threshold, int vertices )
+    {
+        if (_pixels.empty())
+            return false;
+        return BuildHulls(&_pixels[3], 4, GetTextureWidth() * 4, threshold, vertices);
+    }
+
+    const unsigned char* SoftwareImage::GetPixels() const
+    {
+        return _pixels.empty() ? NULL : &_pixels[0];
+    }
+
+    static bool DecodeTGA( FILE *file, std::vector<unsigned char>& rgba, int& width, int& height )
+    {
+        unsigned char header[18];
+        bool read = fread(header, 1, sizeof(header), file) == sizeof(header);
+        int type = header[2], bits = header[16];
+        width = header[12] | (header[13] << 8);
+        height = header[14] | (header[15] << 8);
+        if (!read || header[1] != 0 || (type != 2 && type != 10) || (bits != 24 && bits != 32) || width == 0 || height == 0
+            || fseek(file, header[0], SEEK_CUR) != 0)
+            return false;
+
+        int bytes = bits / 8, count = width * height;
+        bool topDown = (header[17] & 0x20) != 0;
+        rgba.resize(count * 4);
+
+        unsigned char pixel[4] = { 0, 0, 0, 255 };
+        for (int i = 0; i < count && read; )
+        {
+            int packet = 1;
+            bool run = false;
+            if (type == 10)                         // run length encoded
+            {
+                int c = fgetc(file);
+                packet = (c & 0x7f) + 1;
+                run = (c & 0x80) != 0;
+                read = c != EOF;
+            }
+
+            for (int j = 0; j < packet && i < count && read; ++j, ++i)
+            {
+                if (j == 0 || !run)
+                    read = fread(pixel, 1, bytes, file) == (size_t)bytes;
+
+                int row = topDown ? i / width : height - 1 - i / width;
+                unsigned char *out = &rgba[(row * width + i % width) * 4];
+                out[0] = pixel[2];                  // stored as BGRA
+                out[1] = pixel[1];
+                out[2] = pixel[0];
+                out[3] = pixel[3];
+            }
+        }
+        return read;
+    }
+
+    // the zlib stream of a PNG, see Inflate
+    struct InflateStream
+    {
+        const unsigned char*        in;
+        size_t                      size;
+        size_t                      pos;
+        unsigned int                bits;               // bit buffer, the next bit in the lowest one
+        int                         bitCount;
+        bool                        error;              // read past the end or an invalid code
+        std::vector<unsigned char>  out;
+    };
+
+    // canonical Huffman code, as the number of codes of every length and the symbols ordered by code
+    struct HuffmanCode
+    {
+        short                       count[16];
+        short                       symbol[288];
+    };
+
+    static int GetBits( InflateStream& s, int need )
+    {
+        while (s.bitCount < need)
+        {
+            if (s.pos == s.size)
+            {
+                s.error = true;
+                return 0;
+            }
+            s.bits |= (unsigned int)s.in[s.pos++] << s.bitCount;
+            s.bitCount += 8;
+        }
+        int value = (int)(s.bits & ((1u << need) - 1));
+        s.bits >>= need;
+        s.bitCount -= need;
+        return value;
+    }
+
+    static bool BuildCode( HuffmanCode& code, const unsigned char *lengths, int n )
+    {
+        memset(code.count, 0, sizeof(code.count));
+        for (int i = 0; i < n; ++i)
+            ++code.count[lengths[i]];
+
+        // over subscribed lengths are an error, incomplete ones only fail if a missing code is read
+        int left = 1;
+        for (int len = 1; len < 16; ++len)
+        {
+            left = (left << 1) - code.count[len];
+            if (left < 0)
+                return false;
+        }
+
+        short offsets[16];
+        offsets[1] = 0;
+        for (int len = 1; len < 15; ++len)
+            offsets[len + 1] = offsets[len] + code.count[len];
+        for (int i = 0; i < n; ++i)
+        {
+            if (lengths[i] != 0)
+                code.symbol[offsets[lengths[i]]++] = (short)i;
+        }
+        return true;
+    }
+
+    static int DecodeSymbol( InflateStream& s, const HuffmanCode& code )
+    {
+        int value = 0, first = 0, index = 0;
+        for (int len = 1; len < 16; ++len)
+        {
+            value |= GetBits(s, 1);
+            int count = code.count[len];
+            if (value - first < count)
+                return code.symbol[index + value - first];
+            index += count;
+            first = (first + count) << 1;
+            value <<= 1;
+        }
+        s.error = true;
+        return -1;
+    }
+
+    static bool InflateCodes( InflateStream& s, const HuffmanCode& lengthCode, const HuffmanCode& distanceCode )
+    {
+        static const short lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131,
+            163, 195, 227, 258 };
+        static const short lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static const short distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537,
+            2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        static const short distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12,
+            13, 13 };
+
+        for (;;)
+        {
+            int symbol = DecodeSymbol(s, lengthCode);
+            if (s.error)
+                return false;
+            if (symbol < 256)
+            {
+                s.out.push_back((unsigned char)symbol);
+            }
+            else if (symbol == 256)
+            {
+                return true;                        // end of block
+            }
+            else
+            {
+                symbol -= 257;
+                if (symbol >= 29)
+                    return false;
+                size_t length = lengthBase[symbol] + GetBits(s, lengthExtra[symbol]);
+
+                symbol = DecodeSymbol(s, distanceCode);
+                if (s.error || symbol < 0 || symbol >= 30)
+                    return false;
+                size_t distance = distanceBase[symbol] + GetBits(s, distanceExtra[symbol]);
+                if (s.error || distance > s.out.size())
+                    return false;
+
+                size_t from = s.out.size() - distance;
+                for (size_t i = 0; i < length; ++i)
+                    s.out.push_back(s.out[from + i]);    // may overlap what is being copied
+            }
+        }
+    }
+
+    // a zlib stream, without checking the Adler-32 checksum
+    static bool Inflate( InflateStream& s )
+    {
+        if (s.size < 2 || (s.in[0] & 0x0f) != 8 || ((s.in[0] << 8) | s.in[1]) % 31 != 0 || (s.in[1] & 0x20) != 0)
+            return false;                           // not deflate, or a preset dictionary
+        s.pos = 2;
+
+        HuffmanCode lengthCode, distanceCode;
+        int last;
+        do
+        {
+            last = GetBits(s, 1);
+            int type = GetBits(s, 2);
+            if (s.error)
+                return false;
+
+            if (type == 0)                          // stored
+            {
+                s.bits = 0;
+                s.bitCount = 0;
+                if (s.pos + 4 > s.size)
+                    return false;
+                size_t length = s.in[s.pos] | (s.in[s.pos + 1] << 8);
+                size_t inverse = s.in[s.pos + 2] | (s.in[s.pos + 3] << 8);
+                s.pos += 4;
+                if (length != (~inverse & 0xffff) || s.pos + length > s.size)
+                    return false;
+                s.out.insert(s.out.end(), s.in + s.pos, s.in + s.pos + length);
+                s.pos += length;
+            }
+            else if (type == 1)                     // fixed codes
+            {
+                unsigned char lengths[288];
+                int i = 0;
+                for (; i < 144; ++i) lengths[i] = 8;
+                for (; i < 256; ++i) lengths[i] = 9;
+                for (; i < 280; ++i) lengths[i] = 7;
+                for (; i < 288; ++i) lengths[i] = 8;
+                BuildCode(lengthCode, lengths, 288);
+                for (i = 0; i < 30; ++i) lengths[i] = 5;
+                BuildCode(distanceCode, lengths, 30);
+                if (!InflateCodes(s, lengthCode, distanceCode))
+                    return false;
+            }
+            else if (type == 2)                     // dynamic codes
+            {
+                static const unsigned char order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+                int lengthCount = GetBits(s, 5) + 257;
+                int distanceCount = GetBits(s, 5) + 1;
+                int codeCount = GetBits(s, 4) + 4;
+                if (s.error || lengthCount > 286 || distanceCount > 30)
+                    return false;
+
+                unsigned char lengths[288 + 32];
+                memset(lengths, 0, sizeof(lengths));
+                for (int i = 0; i < codeCount; ++i)
+                    lengths[order[i]] = (unsigned char)GetBits(s, 3);
+                HuffmanCode code;
+                if (s.error || !BuildCode(code, lengths, 19))
+                    return false;
+
+                // the lengths of both codes, run length encoded
+                for (int i = 0; i < lengthCount + distanceCount; )
+                {
+                    int symbol = DecodeSymbol(s, code);
+                    if (s.error)
+                        return false;
+                    if (symbol < 16)
+                    {
+                        lengths[i++] = (unsigned char)symbol;
+                        continue;
+                    }
+
+                    int repeat;
+                    unsigned char value = 0;
+                    if (symbol == 16)
+                    {
+                        if (i == 0)
+                            return false;
+                        value = lengths[i - 1];
+                        repeat = 3 + GetBits(s, 2);
+                    }
+                    else if (symbol == 17)
+                        repeat = 3 + GetBits(s, 3);
+                    else
+                        repeat = 11 + GetBits(s, 7);
+                    if (s.error || i + repeat > lengthCount + distanceCount)
+                        return false;
+                    while (repeat--)
+                        lengths[i++] = value;
+                }
+
+                if (lengths[256] == 0 || !BuildCode(lengthCode, lengths, lengthCount)
+                    || !BuildCode(distanceCode, lengths + lengthCount, distanceCount)
+                    || !InflateCodes(s, lengthCode, distanceCode))
+                    return false;
+            }
+            else
+            {
+                return false;
+            }
+        } while (!last);
+
+        return true;
+    }
+
+    static unsigned int ReadBigEndian( const unsigned char *p )
+    {
+        return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+    }
+
+    static int Paeth( int a, int b, int c )
+    {
+        int p = a + b - c;
+        int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+        if (pa <= pb && pa <= pc)
+            return a;
+        return pb <= pc ? b : c;
+    }
+
+    // 8 bit grey, true color, palette, grey with alpha and true color with alpha images, not interlaced. CRCs aren't checked.
+    static bool DecodePNG( FILE *file, std::vector<unsigned char>& rgba, int& width, int& height )
+    {
+        std::vector<unsigned char> data;
+        unsigned char buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            data.insert(data.end(), buffer, buffer + read);
+
+        static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        if (data.size() < 8 || memcmp(&data[0], signature, 8) != 0)
+            return false;
+
+        int bitDepth = 0, colorType = -1, interlace = 0;
+        unsigned char palette[256 * 4];
+        unsigned char transparent[6];                       // grey or RGB of the transparent color, 16 bit each
+        bool hasTransparent = false;
+        memset(palette, 255, sizeof(palette));
+        width = height = 0;
+
+        InflateStream s;
+        std::vector<unsigned char> compressed;
+        for (size_t pos = 8; pos + 12 <= data.size(); )
+        {
+            size_t length = ReadBigEndian(&data[pos]);
+            const unsigned char *type = &data[pos + 4];
+            const unsigned char *chunk = &data[pos + 8];
+            if (length > data.size() - pos - 12)
+                return false;
+
+            if (memcmp(type, "IHDR", 4) == 0 && length >= 13)
+            {
+                width = (int)ReadBigEndian(chunk);
+                height = (int)ReadBigEndian(chunk + 4);
+                bitDepth = chunk[8];
+                colorType = chunk[9];
+                interlace = chunk[12];
+            }
+            else if (memcmp(type, "PLTE", 4) == 0)
+            {
+                for (size_t i = 0; i < length / 3 && i < 256; ++i)
+                    memcpy(&palette[i * 4], chunk + i * 3, 3);
+            }
+            else if (memcmp(type, "tRNS", 4) == 0)
+            {
+                if (colorType == 3)
+                {
+                    for (size_t i = 0; i < length && i < 256; ++i)
+                        palette[i * 4 + 3] = chunk[i];
+                }
+                else if (length <= sizeof(transparent))
+                {
+                    memcpy(transparent, chunk, length);
+                    hasTransparent = true;
+                }
+            }
+            else if (memcmp(type, "IDAT", 4) == 0)
+            {
+                compressed.insert(compressed.end(), chunk, chunk + length);
+            }
+            else if (memcmp(type, "IEND", 4) == 0)
+            {
+                break;
+            }
+            pos += length + 12;
+        }
+
+        static const int channelCounts[7] = { 1, 0, 3, 1, 2, 0, 4 };
+        if (width <= 0 || height <= 0 || width > 16384 || height > 16384 || bitDepth != 8 || colorType < 0 || colorType > 6
+            || channelCounts[colorType] == 0 || interlace != 0 || compressed.empty())
+            return false;
+
+        s.in = &compressed[0];
+        s.size = compressed.size();
+        s.pos = 0;
+        s.bits = 0;
+        s.bitCount = 0;
+        s.error = false;
+        int channels = channelCounts[colorType];
+        size_t stride = (size_t)width * channels;
+        if ((stride + 1) * height > compressed.size() * 1032)
+            return false;                           // more than deflate can expand to
+        s.out.reserve((stride + 1) * height);
+        if (!Inflate(s) || s.out.size() < (stride + 1) * height)
+            return false;
+
+        // undo the filter of every row, in place
+        for (int y = 0; y < height; ++y)
+        {
+            unsigned char *row = &s.out[y * (stride + 1)];
+            int filter = row[0];
+            unsigned char *line = row + 1;
+            const unsigned char *above = y > 0 ? line - (stride + 1) : NULL;
+            for (size_t x = 0; x < stride; ++x)
+            {
+                int a = x >= (size_t)channels ? line[x - channels] : 0;
+                int b = above ? above[x] : 0;
+                int c = above && x >= (size_t)channels ? above[x - channels] : 0;
+                switch (filter)
+                {
+                case 0:                                 break;
+                case 1: line[x] += (unsigned char)a;    break;
+                case 2: line[x] += (unsigned char)b;    break;
+                case 3: line[x] += (unsigned char)((a + b) / 2);    break;
+                case 4: line[x] += (unsigned char)Paeth(a, b, c);   break;
+                default: return false;
+                }
+            }
+        }
+
+        rgba.resize((size_t)width * height * 4);
+        for (int y = 0; y < height; ++y)
+        {
+            const unsigned char *in = &s.out[y * (stride + 1) + 1];
+            unsigned char *out = &rgba[(size_t)y * width * 4];
+            for (int x = 0; x < width; ++x, in += channels, out += 4)
+            {
+                switch (colorType)
+                {
+                case 0:
+                    out[0] = out[1] = out[2] = in[0];
+                    out[3] = hasTransparent && transparent[1] == in[0] ? 0 : 255;
+                    break;
+                case 2:
+                    out[0] = in[0];
+                    out[1] = in[1];
+                    out[2] = in[2];
+                    out[3] = hasTransparent && transparent[1] == in[0] && transparent[3] == in[1] && transparent[5] == in[2] ? 0 : 255;
+                    break;
+                case 3:
+                    memcpy(out, &palette[in[0] * 4], 4);
+                    break;
+                case 4:
+                    out[0] = out[1] = out[2] = in[0];
+                    out[3] = in[1];
+                    break;
+                case 6:
+                    memcpy(out, in, 4);
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool SoftwareImage::Decode( const char *filename, std::vector<unsigned char>& rgba, int& width, int& height )
+    {
+        FILE *file = fopen(filename, "rb");
+        if (!file)
+            return false;
+
+        unsigned char magic[4];
+        bool png = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, "\x89PNG", 4) == 0;
+        rewind(file);
+        bool decoded = png ? DecodePNG(file, rgba, width, height) : DecodeTGA(file, rgba, width, height);
+
+        fclose(file);
+        return decoded;
+    }
+
+
+
+#ifdef TLFX_SOFTWARE_SSE2
+
+    typedef __m128 Pixel;
+
+    static inline Pixel LoadTexel(const unsigned char *texel)
+    {
+        int value;
+        memcpy(&value, texel, sizeof(value));
+        __m128i zero = _mm_setzero_si128();
+        __m128i wide = _mm_unpacklo_epi8(_mm_cvtsi32_si128(value), zero);
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(wide, zero));
+    }
+
+    static inline Pixel Lerp(Pixel a, Pixel b, float t)
+    {
+        return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(t)));
+    }
+
+    static inline void BlendPixel(float *dst, Pixel texel, const float *color)
+    {
+        Pixel src = _mm_mul_ps(texel, _mm_loadu_ps(color));
+        Pixel inverse = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_shuffle_ps(src, src, _MM_SHUFFLE(3, 3, 3, 3)));
+        _mm_storeu_ps(dst, _mm_add_ps(src, _mm_mul_ps(_mm_loadu_ps(dst), inverse)));
+    }
+
+#else
+
+    struct Pixel
+    {
+        float c[4];
+    };
+
+    static inline Pixel LoadTexel(const unsigned char *texel)
+    {
+        Pixel p = { { texel[0], texel[1], texel[2], texel[3] } };
+        return p;
+    }
+
+    static inline Pixel Lerp(Pixel a, Pixel b, float t)
+    {
+        for (int i = 0; i < 4; ++i)
+            a.c[i] += (b.c[i] - a.c[i]) * t;
+        return a;
+    }
+
+    static inline void BlendPixel(float *dst, Pixel texel, const float *color)
+    {
+        float inverse = 1.0f - texel.c[3] * color[3];
+        for (int i = 0; i < 4; ++i)
+            dst[i] = texel.c[i] * color[i] + dst[i] * inverse;
+    }
+
+#endif
+
+    // narrows [first, last] to the steps k with value + k * step >= 0
+    static bool ClipSpan(float value, float step, float& first, float& last)
+    {
+        if (step == 0)
+            return value >= 0;
+
+        if (step > 0)
+            first = std::max(first, -value / step);
+        else
+            last = std::min(last, -value / step);
+        return first <= last;
+    }
+
+    SoftwareParticleManager::SoftwareParticleManager( int particles /*= particleLimit*/, int layers /*= 1*/ )
+        : BasicParticleManager<SoftwareParticleManager>(particles, layers)
+        , _framebufferWidth(0)
+        , _framebufferHeight(0)
+    {
+
+    }
+
+    void SoftwareParticleManager::SetFramebufferSize( int width, int height )
+    {
+        assert(width > 0 && height > 0);
+
+        _framebufferWidth = width;
+        _framebufferHeight = height;
+        _framebuffer.resize(width * height * 4);
+        Clear();
+    }
+
+    int SoftwareParticleManager::GetFramebufferWidth() const
+    {
+        return _framebufferWidth;
+    }
+
+    int SoftwareParticleManager::GetFramebufferHeight() const
+    {
+        return _framebufferHeight;
+    }
+
+    void SoftwareParticleManager::Clear( float r /*= 0*/, float g /*= 0*/, float b /*= 0*/, float a /*= 0*/ )
+    {
+        for (size_t i = 0; i < _framebuffer.size(); i += 4)
+        {
+            _framebuffer[i + 0] = r;
+            _framebuffer[i + 1] = g;
+            _framebuffer[i + 2] = b;
+            _framebuffer[i + 3] = a;
+        }
+    }
+
+    void SoftwareParticleManager::Flush()
+    {
+        if (_sprites.empty())
+            return;
+
+        int columns = (_framebufferWidth + tileSize - 1) / tileSize;
+        int rows = (_framebufferHeight + tileSize - 1) / tileSize;
+        _tiles.resize(columns * rows);
+        for (auto it = _tiles.begin(); it != _tiles.end(); ++it)
+            it->clear();
+
+        for (int i = 0; i < (int)_sprites.size(); ++i)
+        {
+            const Sprite& sprite = _sprites[i];
+            for (int row = sprite.top / tileSize; row <= (sprite.bottom - 1) / tileSize; ++row)
+            {
+                for (int column = sprite.left / tileSize; column <= (sprite.right - 1) / tileSize; ++column)
+                    _tiles[row * columns + column].push_back(i);
+            }
+        }
+
+        // tiles don't share pixels, so they are rasterized in parallel without changing the result
+        GetTaskScheduler()->ParallelFor((int)_tiles.size(), 1, [this](int begin, int end)
+        {
+            for (int i = begin; i < end; ++i)
+                RasterizeTile(i);
+        });
+
+        _sprites.clear();
+    }
+
+    const float* SoftwareParticleManager::GetFramebuffer() const
+    {
+        return _framebuffer.empty() ? NULL : &_framebuffer[0];
+    }
+
+    void SoftwareParticleManager::ReadPixels( unsigned char *rgba ) const
+    {
+        for (size_t i = 0; i < _framebuffer.size(); ++i)
+            rgba[i] = (unsigned char)(std::min(std::max(_framebuffer[i], 0.0f), 1.0f) * 255 + 0.5f);
+    }
+
+    bool SoftwareParticleManager::SaveImage( const char *filename ) const
+    {
+        FILE *file = fopen(filename, "wb");
+        if (!file)
+            return false;
+
+        unsigned char header[18] = { 0 };
+        header[2] = 2;                              // uncompressed true color
+        header[12] = (unsigned char)(_framebufferWidth & 0xff);
+        header[13] = (unsigned char)(_framebufferWidth >> 8);
+        header[14] = (unsigned char)(_framebufferHeight & 0xff);
+        header[15] = (unsigned char)(_framebufferHeight >> 8);
+        header[16] = 32;
+        header[17] = 0x28;                          // 8 alpha bits, top down
+        bool written = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+
+        std::vector<unsigned char> pixels(_framebuffer.size());
+        if (!pixels.empty())
+        {
+            ReadPixels(&pixels[0]);
+            for (size_t i = 0; i < pixels.size(); i += 4)
+                std::swap(pixels[i], pixels[i + 2]);
+            written = written && fwrite(&pixels[0], 1, pixels.size(), file) == pixels.size();
+        }
+
+        return fclose(file) == 0 && written;
+    }
+
+    void SoftwareParticleManager::RasterizeTile( int tile )
+    {
+        int columns = (_framebufferWidth + tileSize - 1) / tileSize;
+        int left = (tile % columns) * tileSize, top = (tile / columns) * tileSize;
+        int right = std::min(left + (int)tileSize, _framebufferWidth), bottom = std::min(top + (int)tileSize, _framebufferHeight);
+
+        const std::vector<int>& sprites = _tiles[tile];
+        for (auto it = sprites.begin(); it != sprites.end(); ++it)
+        {
+            const Sprite& sprite = _sprites[*it];
+            RasterizeSprite(sprite, std::max(left, sprite.left), std::max(top, sprite.top), std::min(right, sprite.right), std::min(bottom, sprite.bottom));
+        }
+    }
+
+    void SoftwareParticleManager::RasterizeSprite( const Sprite& sprite, int left, int top, int right, int bottom )
+    {
+        // s and t are the position across the top and the left edge, from 0 to 1
+        float det = sprite.ux * sprite.vy - sprite.uy * sprite.vx;
+        if (fabsf(det) < 1e-6f)
+            return;
+        float dsdx = sprite.vy / det, dtdx = -sprite.uy / det;
+
+        const int lastX = sprite.width - 1, lastY = sprite.height - 1;
+        for (int y = top; y < bottom; ++y)
+        {
+            float dx = left + 0.5f - sprite.x, dy = y + 0.5f - sprite.y;
+            float s0 = (dx * sprite.vy - dy * sprite.vx) / det;
+            float t0 = (sprite.ux * dy - sprite.uy * dx) / det;
+
+            // inside every edge of the outline, p to q, the cross product of q - p and s,t - p is positive
+            float first = 0, last = (float)(right - left - 1);
+            bool inside = true;
+            for (int i = 0; i < sprite.hullCount && inside; ++i)
+            {
+                const Vector2& p = sprite.hull[i];
+                const Vector2& q = sprite.hull[(i + 1) % sprite.hullCount];
+                float ex = q.x - p.x, ey = q.y - p.y;
+                inside = ClipSpan(ex * (t0 - p.y) - ey * (s0 - p.x), ex * dtdx - ey * dsdx, first, last);
+            }
+            if (!inside)
+                continue;
+
+            int begin = (int)ceilf(first), end = (int)floorf(last);
+            float *dst = &_framebuffer[(y * _framebufferWidth + left + begin) * 4];
+            for (int k = begin; k <= end; ++k, dst += 4)
+            {
+                float u = std::min(std::max((s0 + k * dsdx) * sprite.width - 0.5f, 0.0f), (float)lastX);
+                float v = std::min(std::max((t0 + k * dtdx) * sprite.height - 0.5f, 0.0f), (float)lastY);
+                int iu = (int)u, iv = (int)v;
+                int nu = std::min(iu + 1, lastX) - iu, nv = std::min(iv + 1, lastY) - iv;
+
+                const unsigned char *texel = sprite.pixels + ((sprite.frameY + iv) * sprite.pitch + sprite.frameX + iu) * 4;
+                Pixel upper = Lerp(LoadTexel(texel), LoadTexel(texel + nu * 4), u - iu);
+                texel += nv * sprite.pitch * 4;
+                Pixel lower = Lerp(LoadTexel(texel), LoadTexel(texel + nu * 4), u - iu);
+                BlendPixel(dst, Lerp(upper, lower, v - iv), sprite.color);
+            }
+        }
+    }
+
+    void SoftwareParticleManager::DrawSprite( AnimImage* sprite, float px, float py, float frame, float x, float y, float rotation, float scaleX, float scaleY, unsigned char r, unsigned char g, unsigned char b, float a, bool additive )
+    {
+        const unsigned char *pixels = static_cast<SoftwareImage*>(sprite)->GetPixels();
+        float alpha = std::min(std::max(a, 0.0f), 1.0f);
+        if (!pixels || scaleX == 0 || scaleY == 0 || (alpha == 0 && !_premultipliedAlpha))
+            return;
+
+        Sprite s;
+        s.pixels = pixels;
+        s.pitch = sprite->GetTextureWidth();
+        s.width = (int)sprite->GetWidth();
+        s.height = (int)sprite->GetHeight();
+        sprite->GetFrameSource((int)frame, s.frameX, s.frameY);
+        if (s.width <= 0 || s.height <= 0 || s.frameX + s.width > s.pitch || s.frameY + s.height > sprite->GetTextureHeight())
+            return;                                 // frames don't match the image
+
+        s.hullCount = sprite->GetFrameHull((int)frame, s.hull);
+        if (s.hullCount < 3)
+            return;                                 // nothing visible in the frame
+        GetSpriteEdges(sprite, px, py, x, y, rotation, scaleX, scaleY, s.x, s.y, s.ux, s.uy, s.vx, s.vy);
+
+        // everything is blended as premultiplied, additive particles add their color without covering what is below
+        const float scale = 1.0f / (255.0f * 255.0f);
+        float premultiply = _premultipliedAlpha ? 1.0f : alpha;
+        s.color[0] = r * premultiply * scale;
+        s.color[1] = g * premultiply * scale;
+        s.color[2] = b * premultiply * scale;
+        s.color[3] = additive && !_premultipliedAlpha ? 0 : alpha / 255.0f;
+
+        float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+        for (int i = 0; i < s.hullCount; ++i)
+        {
+            float hx = s.x + s.hull[i].x * s.ux + s.hull[i].y * s.vx;
+            float hy = s.y + s.hull[i].x * s.uy + s.hull[i].y * s.vy;
+            minX = std::min(minX, hx);
+            maxX = std::max(maxX, hx);
+            minY = std::min(minY, hy);
+            maxY = std::max(maxY, hy);
+        }
+        if (maxX <= 0 || maxY <= 0 || minX >= _framebufferWidth || minY >= _framebufferHeight)
+            return;
+        s.left = std::max((int)floorf(minX), 0);
+        s.top = std::max((int)floorf(minY), 0);
+        s.right = std::min((int)ceilf(maxX), _framebufferWidth);
+        s.bottom = std::min((int)ceilf(maxY), _framebufferHeight);
+
+        _sprites.push_back(s);
+    }
+
+} // namespace TLFX
@@ -0,0 +1,149 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+/*
+ * Software rasterizer for rendering, without any graphics API
+ * PugiXML for parsing data
+ */
+
+#ifndef _TLFX_SOFTWAREEFFECTSLIBRARY_H
+#define _TLFX_SOFTWAREEFFECTSLIBRARY_H
+
+#include "TLFXEffectsLibrary.h"
+#include "TLFXBasicParticleManager.h"
+#include "TLFXAnimImage.h"
+
+#include <vector>
+
+namespace TLFX
+{
+
+    class SoftwareEffectsLibrary : public EffectsLibrary
+    {
+    public:
+        virtual XMLLoader* CreateLoader() const;
+        virtual AnimImage* CreateImage() const;
+    };
+
+    /**
+     * Software Particle Manager type
+     * <p>Renders the particles into an RGBA framebuffer in memory on the CPU, for effect thumbnails, render benchmarks and comparing frames
+     * against reference images where there is no GPU. Draw as usual and call #Flush once all particles of the frame are drawn:</p>
+     * &{<pre>
+     * myParticleManager->SetFramebufferSize(256, 256);
+     * myParticleManager->SetScreenSize(256, 256);
+     * myParticleManager->Clear();
+     * myParticleManager->DrawParticles();
+     * myParticleManager->Flush();
+     * myParticleManager->SaveImage("thumbnail.tga");
+     * </pre>}
+     * <p>The framebuffer is split into tiles of #tileSize pixels. #Flush sorts the drawn sprites into the tiles they touch and rasterizes the
+     * tiles in parallel on the #TaskScheduler, every tile blending its sprites in drawing order, so the result doesn't depend on the number
+     * of threads. Sprites are rotated and scaled like in the other integrations, textures are filtered bilinearly and both alpha and
+     * additive blending are supported, as well as the premultiplied alpha output of ParticleManager::SetPremultipliedAlpha. Only the pixels
+     * inside the outline of trimmed frames are touched, see EffectsLibrary::TrimShapes.</p>
+     * <p>Pixels are kept as floats with premultiplied alpha, so additive particles don't clip until the framebuffer is read.</p>
+     * <p>DrawSprite is called without the virtual dispatch, so overriding it in a derived class has no effect, see #BasicParticleManager.</p>
+     */
+    class SoftwareParticleManager : public BasicParticleManager<SoftwareParticleManager>
+    {
+        friend class ParticleManager;           // calls DrawSprite inlined
+    public:
+        enum { tileSize = 64 };
+
+        SoftwareParticleManager(int particles = ParticleManager::particleLimit, int layers = 1);
+
+        /**
+         * Set the size of the framebuffer, in pixels
+         * Usually the same as the screen size of the particle manager, see ParticleManager::SetScreenSize. The framebuffer is cleared.
+         */
+        void SetFramebufferSize(int width, int height);
+        int GetFramebufferWidth() const;
+        int GetFramebufferHeight() const;
+
+        /**
+         * Fill the framebuffer with a color, components from 0 to 1 with premultiplied alpha
+         */
+        void Clear(float r = 0, float g = 0, float b = 0, float a = 0);
+
+        /**
+         * Rasterize the sprites drawn since the last flush into the framebuffer
+         */
+        void Flush();
+
+        /**
+         * Get the framebuffer, 4 floats per pixel in RGBA order, with premultiplied alpha, row by row from the top
+         */
+        const float* GetFramebuffer() const;
+
+        /**
+         * Copy the framebuffer as RGBA8 with premultiplied alpha to rgba, which needs room for width * height * 4 bytes
+         */
+        void ReadPixels(unsigned char *rgba) const;
+
+        /**
+         * Write the framebuffer to an uncompressed 32 bit TGA file
+         */
+        bool SaveImage(const char *filename) const;
+
+    protected:
+        struct Sprite
+        {
+            const unsigned char* pixels;            // premultiplied RGBA8 of the image
+            int pitch;                              // in pixels
+            int frameX, frameY;                     // of the frame in the image
+            int width, height;
+            float x, y;                             // top left corner on the screen
+            float ux, uy;                           // top edge
+            float vx, vy;                           // left edge
+            float color[4];                         // premultiplied, scaled to texels from 0 to 255
+            const Vector2* hull;                    // outline of the frame, see AnimImage::GetFrameHull
+            int hullCount;
+            int left, top, right, bottom;           // bounding box in pixels, right and bottom excluded
+        };
+
+        std::vector<float>              _framebuffer;
+        int                             _framebufferWidth;
+        int                             _framebufferHeight;
+        std::vector<Sprite>             _sprites;
+        std::vector<std::vector<int> >  _tiles;                 // indices of the sprites touching each tile, in drawing order
+
+        void RasterizeTile(int tile);
+        void RasterizeSprite(const Sprite& sprite, int left, int top, int right, int bottom);
+
+        virtual void DrawSprite(AnimImage* sprite, float px, float py, float frame, float x, float y, float rotation,
+            float scaleX, float scaleY, unsigned char r, unsigned char g, unsigned char b, float a, bool additive);
+    };
+
+    class SoftwareImage : public AnimImage
+    {
+    public:
+        virtual bool Load(const char *filename);
+        virtual bool Trim(int threshold, int vertices);
+
+        /**
+         * Set the pixels of the image, RGBA8 with straight alpha, row by row from the top
+         */
+        void SetPixels(const unsigned char *rgba, int width, int height);
+
+        /**
+         * Get the pixels, RGBA8 with premultiplied alpha
+         * @return NULL if no pixels are set
+         */
+        const unsigned char* GetPixels() const;
+
+    protected:
+        std::vector<unsigned char> _pixels;
+
+        /**
+         * Read an image file into RGBA8 pixels with straight alpha
+         * <p>Reads PNG files with 8 bits per channel, grey, true color or palette, with or without alpha, but not interlaced, as well as
+         * uncompressed and run length encoded true color TGA files. Override it to read other formats.</p>
+         */
+        virtual bool Decode(const char *filename, std::vector<unsigned char>& rgba, int& width, int& height);
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_SOFTWAREEFFECTSLIBRARY_H
@@ -0,0 +1,194 @@
+#include "TLFXTaskScheduler.h"
+
+#include <cassert>
+#include <algorithm>
+
+namespace TLFX
+{
+
+    std::atomic<TaskScheduler*> TaskScheduler::_default(NULL);
+
+    void TaskScheduler::ParallelFor( int count, int grain, const RangeFunction& body )
+    {
+        if (count <= 0)
+            return;
+
+        if (count <= grain || GetWorkerCount() <= 1)
+        {
+            body(0, count);
+            return;
+        }
+
+        WaitGroup group;
+        Submit(group, count, grain, body);
+        Wait(group);
+    }
+
+    TaskScheduler* TaskScheduler::GetDefault()
+    {
+        TaskScheduler* scheduler = _default.load(std::memory_order_acquire);
+        if (!scheduler)
+        {
+            static SerialTaskScheduler serialScheduler;
+            TaskScheduler* expected = NULL;
+            _default.compare_exchange_strong(expected, &serialScheduler);
+            scheduler = _default.load(std::memory_order_acquire);
+        }
+        return scheduler;
+    }
+
+    void TaskScheduler::SetDefault( TaskScheduler* scheduler )
+    {
+        _default.store(scheduler, std::memory_order_release);
+    }
+
+    void SerialTaskScheduler::Submit( WaitGroup& /*group*/, int count, int /*grain*/, const RangeFunction& body )
+    {
+        if (count > 0)
+            body(0, count);
+    }
+
+    void SerialTaskScheduler::Wait( WaitGroup& group )
+    {
+        assert(group.IsDone());             // Submit ran everything
+        (void)group;
+    }
+
+    int SerialTaskScheduler::GetWorkerCount() const
+    {
+        return 1;
+    }
+
+    ThreadTaskScheduler::ThreadTaskScheduler( int threads /*= -1*/ )
+        : _queued(0)
+        , _nextQueue(0)
+        , _quit(false)
+    {
+        if (threads < 0)
+            threads = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+
+        for (int i = 0; i <= threads; ++i)
+            _queues.push_back(new Queue());
+
+        for (int i = 0; i < threads; ++i)
+            _threads.push_back(std::thread(&ThreadTaskScheduler::WorkerLoop, this, i));
+    }
+
+    ThreadTaskScheduler::~ThreadTaskScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+            _quit = true;
+        }
+        _wake.notify_all();
+
+        for (auto it = _threads.begin(); it != _threads.end(); ++it)
+            it->join();
+
+        for (auto it = _queues.begin(); it != _queues.end(); ++it)
+            delete *it;
+    }
+
+    void ThreadTaskScheduler::Submit( WaitGroup& group, int count, int grain, const RangeFunction& body )
+    {
+        if (count <= 0)
+            return;
+
+        grain = std::max(1, grain);
+        int chunks = (count + grain - 1) / grain;
+        group.Add(chunks);
+
+        int queues = (int)_queues.size();
+        for (int begin = 0; begin < count; begin += grain)
+        {
+            Task task;
+            task.body = &body;
+            task.begin = begin;
+            task.end = std::min(count, begin + grain);
+            task.group = &group;
+
+            Queue* queue = _queues[_nextQueue.fetch_add(1, std::memory_order_relaxed) % queues];
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            queue->tasks.push_back(task);
+        }
+        _queued.fetch_add(chunks, std::memory_order_release);
+
+        {
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+        }
+        _wake.notify_all();
+    }
+
+    void ThreadTaskScheduler::Wait( WaitGroup& group )
+    {
+        int shared = (int)_queues.size() - 1;
+        while (!group.IsDone())
+        {
+            if (!RunTask(shared))
+                std::this_thread::yield();
+        }
+    }
+
+    int ThreadTaskScheduler::GetWorkerCount() const
+    {
+        return (int)_threads.size() + 1;
+    }
+
+    bool ThreadTaskScheduler::RunTask( int index )
+    {
+        if (_queued.load(std::memory_order_acquire) == 0)
+            return false;
+
+        Task task;
+        bool found = false;
+
+        // own queue first, newest task
+        {
+            Queue* queue = _queues[index];
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            if (!queue->tasks.empty())
+            {
+                task = queue->tasks.back();
+                queue->tasks.pop_back();
+                found = true;
+            }
+        }
+
+        // steal the oldest task of the others
+        int queues = (int)_queues.size();
+        for (int i = 1; !found && i < queues; ++i)
+        {
+            Queue* queue = _queues[(index + i) % queues];
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            if (!queue->tasks.empty())
+            {
+                task = queue->tasks.front();
+                queue->tasks.pop_front();
+                found = true;
+            }
+        }
+
+        if (!found)
+            return false;
+
+        _queued.fetch_sub(1, std::memory_order_relaxed);
+        (*task.body)(task.begin, task.end);
+        task.group->Done();
+        return true;
+    }
+
+    void ThreadTaskScheduler::WorkerLoop( int index )
+    {
+        for (;;)
+        {
+            if (RunTask(index))
+                continue;
+
+            std::unique_lock<std::mutex> lock(_sleepMutex);
+            _wake.wait(lock, [this] { return _quit || _queued.load(std::memory_order_acquire) > 0; });
+            if (_quit)
+                return;
+        }
+    }
+
+} // namespace TLFX
@@ -0,0 +1,147 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_TASKSCHEDULER_H
+#define _TLFX_TASKSCHEDULER_H
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+
+namespace TLFX
+{
+
+    /**
+     * Task scheduler interface used for all internal parallelism
+     * <p>#ParticleManager uses it for parallel particle updates and snapshot capture, #EffectsLibrary for compiling effects while loading.
+     * Implement this interface on top of your engine's job system and pass it to ParticleManager::SetTaskScheduler, EffectsLibrary::SetTaskScheduler
+     * or #SetDefault, so TimelineFX never creates threads of its own.</p>
+     * <p>Two implementations are included: #SerialTaskScheduler which runs everything on the calling thread and is the default, and
+     * #ThreadTaskScheduler, a work stealing pool of std::threads for applications without a job system of their own:</p>
+     * &{<pre>
+     * static TLFX::ThreadTaskScheduler scheduler;
+     * TLFX::TaskScheduler::SetDefault(&scheduler);
+     * </pre>}
+     * <p>The results of TimelineFX don't depend on the scheduler used.</p>
+     */
+    class TaskScheduler
+    {
+    public:
+        typedef std::function<void(int begin, int end)> RangeFunction;
+
+        /**
+         * Counts the chunks of submitted ranges that haven't finished yet
+         */
+        class WaitGroup
+        {
+        public:
+            WaitGroup() : _pending(0) {}
+
+            void Add(int chunks)        { _pending.fetch_add(chunks, std::memory_order_relaxed); }
+            void Done()                 { _pending.fetch_sub(1, std::memory_order_release); }
+            bool IsDone() const         { return _pending.load(std::memory_order_acquire) == 0; }
+
+        protected:
+            std::atomic<int>    _pending;
+        };
+
+        virtual ~TaskScheduler() {}
+
+        /**
+         * Submit the range [0, count)
+         * body is called with chunks of at most grain items, possibly on other threads and possibly before Submit returns.
+         * body has to stay alive until #Wait returns for the group.
+         */
+        virtual void Submit(WaitGroup& group, int count, int grain, const RangeFunction& body) = 0;
+
+        /**
+         * Wait until every range submitted with the group has finished
+         * Implementations should run pending chunks on the calling thread while waiting.
+         */
+        virtual void Wait(WaitGroup& group) = 0;
+
+        /**
+         * Get the number of threads that can run chunks at the same time, including the waiting thread
+         */
+        virtual int GetWorkerCount() const = 0;
+
+        /**
+         * Submit the range [0, count) and wait for it to finish
+         */
+        void ParallelFor(int count, int grain, const RangeFunction& body);
+
+        /**
+         * Get the scheduler used when none has been set on a particle manager or library
+         * Unless #SetDefault was called this is a #SerialTaskScheduler, so TimelineFX never starts threads the application didn't ask for.
+         */
+        static TaskScheduler* GetDefault();
+        static void SetDefault(TaskScheduler* scheduler);
+
+    protected:
+        static std::atomic<TaskScheduler*> _default;
+    };
+
+    /**
+     * Task scheduler running everything on the calling thread
+     */
+    class SerialTaskScheduler : public TaskScheduler
+    {
+    public:
+        virtual void Submit(WaitGroup& group, int count, int grain, const RangeFunction& body);
+        virtual void Wait(WaitGroup& group);
+        virtual int GetWorkerCount() const;
+    };
+
+    /**
+     * Work stealing task scheduler using std::thread
+     * <p>Every worker has its own queue of chunks, submitted chunks are spread over the queues. Workers take chunks from the back of their own
+     * queue and steal from the front of the others when it runs empty. Threads waiting in #Wait help running chunks.</p>
+     */
+    class ThreadTaskScheduler : public TaskScheduler
+    {
+    public:
+        /**
+         * Create the scheduler with the given number of worker threads
+         * By default one worker less than there are cores is created, the thread calling #Wait is the last worker.
+         */
+        ThreadTaskScheduler(int threads = -1);
+        virtual ~ThreadTaskScheduler();
+
+        virtual void Submit(WaitGroup& group, int count, int grain, const RangeFunction& body);
+        virtual void Wait(WaitGroup& group);
+        virtual int GetWorkerCount() const;
+
+    protected:
+        struct Task
+        {
+            const RangeFunction*    body;
+            int                     begin, end;
+            WaitGroup*              group;
+        };
+
+        struct Queue
+        {
+            std::mutex              mutex;
+            std::deque<Task>        tasks;
+        };
+
+        std::vector<std::thread>    _threads;
+        std::vector<Queue*>         _queues;                // one per worker thread, plus one shared by all other threads
+        std::atomic<int>            _queued;                // tasks in all queues
+        std::atomic<unsigned int>   _nextQueue;             // round robin for Submit
+        std::mutex                  _sleepMutex;
+        std::condition_variable     _wake;
+        bool                        _quit;
+
+        bool RunTask(int queue);
+        void WorkerLoop(int queue);
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_TASKSCHEDULER_H
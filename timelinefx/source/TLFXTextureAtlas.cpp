@@ -0,0 +1,158 @@
+#include "TLFXTextureAtlas.h"
+
+#include <cassert>
+
+namespace TLFX
+{
+
+    TextureAtlas::TextureAtlas( int pageWidth /*= defaultPageSize*/, int pageHeight /*= defaultPageSize*/, int padding /*= defaultPadding*/ )
+        : _pageWidth(pageWidth)
+        , _pageHeight(pageHeight)
+        , _padding(padding)
+        , _usedArea(0)
+    {
+        assert(pageWidth > 0 && pageHeight > 0 && padding >= 0);
+    }
+
+    bool TextureAtlas::Add( int width, int height, Region& region )
+    {
+        assert(width > 0 && height > 0);
+
+        int paddedWidth = width + _padding;
+        int paddedHeight = height + _padding;
+        if (width > _pageWidth || height > _pageHeight)
+            return false;
+        // the padding is only needed towards neighbours, not at the page border
+        if (paddedWidth > _pageWidth)
+            paddedWidth = _pageWidth;
+        if (paddedHeight > _pageHeight)
+            paddedHeight = _pageHeight;
+
+        int page = 0, index = 0, x = 0, y = 0;
+        for (; page < (int)_pages.size(); ++page)
+        {
+            if (FindPosition(_pages[page], paddedWidth, paddedHeight, index, x, y))
+                break;
+        }
+
+        if (page == (int)_pages.size())
+        {
+            Segment empty = { 0, 0, _pageWidth };
+            _pages.push_back(Skyline(1, empty));
+            index = x = y = 0;
+        }
+
+        Place(_pages[page], index, x, y, paddedWidth, paddedHeight);
+        _usedArea += (long)width * height;
+
+        region.page = page;
+        region.x = x;
+        region.y = y;
+        region.width = width;
+        region.height = height;
+        return true;
+    }
+
+    void TextureAtlas::Clear()
+    {
+        _pages.clear();
+        _usedArea = 0;
+    }
+
+    int TextureAtlas::GetPageCount() const
+    {
+        return (int)_pages.size();
+    }
+
+    int TextureAtlas::GetPageWidth() const
+    {
+        return _pageWidth;
+    }
+
+    int TextureAtlas::GetPageHeight() const
+    {
+        return _pageHeight;
+    }
+
+    int TextureAtlas::GetPadding() const
+    {
+        return _padding;
+    }
+
+    float TextureAtlas::GetOccupancy() const
+    {
+        if (_pages.empty())
+            return 0;
+        return (float)_usedArea / ((float)_pageWidth * _pageHeight * _pages.size());
+    }
+
+    bool TextureAtlas::FindPosition( const Skyline& skyline, int width, int height, int& bestIndex, int& bestX, int& bestY ) const
+    {
+        int bestTop = _pageHeight + 1, bestWidth = _pageWidth + 1;
+        for (int i = 0; i < (int)skyline.size(); ++i)
+        {
+            int x = skyline[i].x;
+            if (x + width > _pageWidth)
+                break;
+
+            // the rectangle rests on the highest segment below it
+            int y = 0;
+            int widthLeft = width;
+            for (int j = i; widthLeft > 0; ++j)
+            {
+                assert(j < (int)skyline.size());
+                if (skyline[j].y > y)
+                    y = skyline[j].y;
+                widthLeft -= skyline[j].width;
+            }
+
+            if (y + height > _pageHeight)
+                continue;
+            if (y + height < bestTop || (y + height == bestTop && skyline[i].width < bestWidth))
+            {
+                bestTop = y + height;
+                bestWidth = skyline[i].width;
+                bestIndex = i;
+                bestX = x;
+                bestY = y;
+            }
+        }
+        return bestTop <= _pageHeight;
+    }
+
+    void TextureAtlas::Place( Skyline& skyline, int index, int x, int y, int width, int height )
+    {
+        Segment top = { x, y + height, width };
+        skyline.insert(skyline.begin() + index, top);
+
+        // cut the segments now under the rectangle
+        for (int i = index + 1; i < (int)skyline.size(); )
+        {
+            int covered = x + width - skyline[i].x;
+            if (covered <= 0)
+                break;
+            if (covered < skyline[i].width)
+            {
+                skyline[i].x += covered;
+                skyline[i].width -= covered;
+                break;
+            }
+            skyline.erase(skyline.begin() + i);
+        }
+
+        // merge neighbours at the same height
+        for (int i = 0; i + 1 < (int)skyline.size(); )
+        {
+            if (skyline[i].y == skyline[i + 1].y)
+            {
+                skyline[i].width += skyline[i + 1].width;
+                skyline.erase(skyline.begin() + i + 1);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+
+} // namespace TLFX
@@ -0,0 +1,76 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_TEXTUREATLAS_H
+#define _TLFX_TEXTUREATLAS_H
+
+#include <vector>
+
+namespace TLFX
+{
+
+    /**
+     * Texture Atlas type
+     * <p>Packs rectangles, the frames of the shapes of an #EffectsLibrary, into pages of a fixed size with a skyline packer. Every page keeps
+     * the outline of its filled area as a list of horizontal segments, a rectangle goes where its top ends lowest, so pages fill from the
+     * top down with little waste for the similar sized frames particle libraries have.</p>
+     * <p>Only the placement is worked out here, copying the pixels into the page textures is up to the integration, see
+     * EffectsLibrary::BuildAtlas.</p>
+     */
+    class TextureAtlas
+    {
+    public:
+        enum { defaultPageSize = 2048, defaultPadding = 1 };
+
+        struct Region
+        {
+            int page;
+            int x, y;
+            int width, height;
+        };
+
+        TextureAtlas(int pageWidth = defaultPageSize, int pageHeight = defaultPageSize, int padding = defaultPadding);
+
+        /**
+         * Find room for a width x height rectangle, starting a new page if none of the pages has room left
+         * Padding pixels are kept free right and below of every rectangle against filtering bleeding into neighbours.
+         * @return false if the rectangle is larger than a page
+         */
+        bool Add(int width, int height, Region& region);
+
+        /**
+         * Remove all pages
+         */
+        void Clear();
+
+        int GetPageCount() const;
+        int GetPageWidth() const;
+        int GetPageHeight() const;
+        int GetPadding() const;
+
+        /**
+         * Get the part of the pages covered by rectangles, from 0 to 1
+         */
+        float GetOccupancy() const;
+
+    protected:
+        struct Segment
+        {
+            int x, y, width;
+        };
+        typedef std::vector<Segment> Skyline;
+
+        std::vector<Skyline>            _pages;
+        int                             _pageWidth;
+        int                             _pageHeight;
+        int                             _padding;
+        long                            _usedArea;
+
+        bool FindPosition(const Skyline& skyline, int width, int height, int& bestIndex, int& bestX, int& bestY) const;
+        void Place(Skyline& skyline, int index, int x, int y, int width, int height);
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_TEXTUREATLAS_H
@@ -0,0 +1,24 @@
+#include "TLFXTimeContext.h"
+
+#include <cassert>
+
+namespace TLFX
+{
+
+    TimeContext::TimeContext()
+    {
+        SetUpdateFrequency(30.0f);
+    }
+
+    void TimeContext::SetUpdateFrequency( float freq )
+    {
+        assert(freq > 0);
+        _updateFrequency = freq;
+        _updateTime = 1000.f / _updateFrequency;
+        _currentUpdateTime = _updateFrequency;
+
+        _invUpdateFrequency = 1.0f / _updateFrequency;
+        _invCurrentUpdateTime = 1.0f / _currentUpdateTime;
+    }
+
+} // namespace TLFX
@@ -0,0 +1,47 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_TIMECONTEXT_H
+#define _TLFX_TIMECONTEXT_H
+
+namespace TLFX
+{
+
+    /**
+     * Timing settings used while updating effects
+     * <p>Every #ParticleManager owns its own time context, so several managers can tick at different rates (for example a 60Hz gameplay
+     * manager next to a 20Hz background manager) and can be updated on different threads without sharing any mutable state.
+     * New managers start with a copy of the library wide defaults (see EffectsLibrary::SetUpdateFrequency). Settings meant for all
+     * managers at once, like ParticleManager::SetGlobalAmountScale, stay shared and are not part of the context. Neither are the lookup
+     * frequencies: the tables of the effects are compiled with them, so they are library wide (see EffectsLibrary::CompileSettings).</p>
+     * <p>Reciprocals of the frequency and time are kept alongside the values so the per particle update can multiply instead of divide.</p>
+     */
+    class TimeContext
+    {
+    public:
+        TimeContext();
+
+        /**
+         * Set the update frequency in times per second
+         * The default update frequency is 30 times per second
+         */
+        void  SetUpdateFrequency(float freq);
+        float GetUpdateFrequency() const             { return _updateFrequency; }
+        float GetUpdateTime() const                  { return _updateTime; }
+        float GetCurrentUpdateTime() const           { return _currentUpdateTime; }
+        float GetInvUpdateFrequency() const          { return _invUpdateFrequency; }
+        float GetInvCurrentUpdateTime() const        { return _invCurrentUpdateTime; }
+
+    protected:
+        float                           _updateFrequency;           // times per second
+        float                           _updateTime;                // milliseconds per update
+        float                           _currentUpdateTime;
+
+        float                           _invUpdateFrequency;
+        float                           _invCurrentUpdateTime;
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_TIMECONTEXT_H
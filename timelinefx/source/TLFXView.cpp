@@ -0,0 +1,82 @@
+#include "TLFXView.h"
+
+namespace TLFX
+{
+
+    View::View()
+        : _originX(0)
+        , _originY(0)
+        , _originZ(1.0f)
+        , _oldOriginX(0)
+        , _oldOriginY(0)
+        , _oldOriginZ(1.0f)
+
+        , _angle(0)
+        , _oldAngle(0)
+
+        , _vpW(0)
+        , _vpH(0)
+        , _vpX(0)
+        , _vpY(0)
+        , _centerX(0)
+        , _centerY(0)
+    {
+
+    }
+
+    void View::SetOrigin( float x, float y, float z /*= 1.0f*/ )
+    {
+        _oldOriginX = _originX;
+        _oldOriginY = _originY;
+        _oldOriginZ = _originZ;
+        _originX = x;
+        _originY = y;
+        _originZ = z;
+    }
+
+    void View::SetOriginX( float x )
+    {
+        _oldOriginX = _originX;
+        _originX = x;
+    }
+
+    void View::SetOriginY( float y )
+    {
+        _oldOriginY = _originY;
+        _originY = y;
+    }
+
+    void View::SetOriginZ( float z )
+    {
+        _oldOriginZ = _originZ;
+        _originZ = z;
+    }
+
+    void View::SetAngle( float angle )
+    {
+        _oldAngle = _angle;
+        _angle = angle;
+    }
+
+    void View::SetScreenSize( int w, int h )
+    {
+        _vpW = (float)w;
+        _vpH = (float)h;
+        _centerX = _vpW / 2.0f;
+        _centerY = _vpH / 2.0f;
+    }
+
+    void View::SetScreenPosition( int x, int y )
+    {
+        _vpX = (float)x;
+        _vpY = (float)y;
+    }
+
+    void View::Tick()
+    {
+        _oldOriginX = _originX;
+        _oldOriginY = _originY;
+        _oldOriginZ = _originZ;
+    }
+
+} // namespace TLFX
@@ -0,0 +1,83 @@
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _TLFX_VIEW_H
+#define _TLFX_VIEW_H
+
+namespace TLFX
+{
+
+    /**
+     * View type
+     * <p>The camera and viewport particles are drawn with: an origin and zoom, an angle and the rectangle of the screen drawn to. Every
+     * #ParticleManager has a view of its own, set with ParticleManager::SetOrigin, ParticleManager::SetScreenSize and so on. Any number of
+     * other views can draw the same particles, for split screen, a minimap or a reflection, without updating them again:</p>
+     * &{<pre>
+     * myParticleManager->Update();
+     * leftView.Tick();
+     * rightView.Tick();
+     * myParticleManager->DrawParticles(leftView, tween);
+     * myParticleManager->DrawParticles(rightView, tween);
+     * </pre>}
+     * <p>Like the particles, the origin is tweened from where it was at the last #Tick. Particles outside the viewport of a view are
+     * culled for that view only.</p>
+     */
+    class View
+    {
+    public:
+        View();
+
+        /**
+         * Set the origin and zoom, see ParticleManager::SetOrigin
+         */
+        void  SetOrigin(float x, float y, float z = 1.0f);
+        void  SetOriginX(float x);
+        void  SetOriginY(float y);
+        void  SetOriginZ(float z);
+        float GetOriginX() const                     { return _originX; }
+        float GetOriginY() const                     { return _originY; }
+        float GetOriginZ() const                     { return _originZ; }
+
+        /**
+         * Set the angle particles are rotated by around the origin, see ParticleManager::SetAngle
+         */
+        void  SetAngle(float angle);
+        float GetAngle() const                       { return _angle; }
+
+        /**
+         * Set the size of the viewport, the origin is at its center
+         */
+        void  SetScreenSize(int w, int h);
+        float GetScreenWidth() const                 { return _vpW; }
+        float GetScreenHeight() const                { return _vpH; }
+
+        /**
+         * Set the top left corner of the viewport
+         */
+        void  SetScreenPosition(int x, int y);
+        float GetScreenX() const                     { return _vpX; }
+        float GetScreenY() const                     { return _vpY; }
+
+        /**
+         * Start tweening the origin from where it is now
+         * Call it once per ParticleManager::Update, which does so for the view of the particle manager.
+         */
+        void  Tick();
+
+    protected:
+        friend class ParticleManager;
+
+        float                   _originX, _originY, _originZ;
+        float                   _oldOriginX, _oldOriginY, _oldOriginZ;
+
+        float                   _angle;
+        float                   _oldAngle;
+
+        float                   _vpW, _vpH, _vpX, _vpY;
+        float                   _centerX, _centerY;
+    };
+
+} // namespace TLFX
+
+#endif // _TLFX_VIEW_H